@@ -0,0 +1,73 @@
+#ifndef CPP_PUBSUB__ALPHA_ADAPTATION_HPP_
+#define CPP_PUBSUB__ALPHA_ADAPTATION_HPP_
+
+#include <algorithm>
+#include <cmath>
+
+
+/////////////////// per-axis alpha adaptation ///////////////////
+// Running (O(1) per sample) RMS statistics of
+//   - tracking error:  human target vs. reference
+//   - disagreement:    human target vs. robot target (reference + noise)
+// are turned into a per-axis update of the human share alpha:
+//
+//   score = (e_track + w * e_disagree) / ((1 + w) * target_error)
+//   alpha += clamp(gain * (1 - score), -max_step, max_step)
+//
+// i.e. participants tracking better than target_error get more authority, worse ones get more robot assistance.
+struct AdaptationSettings
+{
+  double target_error {0.01};        // [m RMS]
+  double disagreement_weight {0.5};
+  double gain {0.2};
+  double max_step {0.1};             // largest alpha change per update
+  double min_alpha {0.0};
+  double max_alpha {1.0};
+};
+
+class AlphaAdaptation
+{
+public:
+
+  void reset()
+  {
+    n_ = 0;
+    for (int i=0; i<3; i++) { sum_track_[i] = 0.0; sum_disagree_[i] = 0.0; }
+  }
+
+  void add_sample(const double * human, const double * ref, const double * robot)
+  {
+    for (int i=0; i<3; i++) {
+      double et = human[i] - ref[i];
+      double ed = human[i] - robot[i];
+      sum_track_[i] += et * et;
+      sum_disagree_[i] += ed * ed;
+    }
+    n_++;
+  }
+
+  long num_samples() const { return n_; }
+  double rms_track(int i) const { return (n_ > 0) ? std::sqrt(sum_track_[i] / n_) : 0.0; }
+  double rms_disagree(int i) const { return (n_ > 0) ? std::sqrt(sum_disagree_[i] / n_) : 0.0; }
+
+  // apply the update to alpha = {ax, ay, az} using the samples collected since the last reset
+  void update(double * alpha, const AdaptationSettings & s) const
+  {
+    if (n_ == 0) return;
+    double w = s.disagreement_weight;
+    for (int i=0; i<3; i++) {
+      double score = (rms_track(i) + w * rms_disagree(i)) / ((1.0 + w) * s.target_error);
+      double step = std::clamp(s.gain * (1.0 - score), -s.max_step, s.max_step);
+      alpha[i] = std::clamp(alpha[i] + step, s.min_alpha, s.max_alpha);
+    }
+  }
+
+private:
+
+  long n_ {0};
+  double sum_track_[3] {0.0, 0.0, 0.0};
+  double sum_disagree_[3] {0.0, 0.0, 0.0};
+};
+
+
+#endif  // CPP_PUBSUB__ALPHA_ADAPTATION_HPP_
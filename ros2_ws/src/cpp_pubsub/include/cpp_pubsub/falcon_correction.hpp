@@ -0,0 +1,184 @@
+#ifndef CPP_PUBSUB__FALCON_CORRECTION_HPP_
+#define CPP_PUBSUB__FALCON_CORRECTION_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/////////////////// Falcon position correction ///////////////////
+// A regular nx x ny x nz grid over the device workspace stores the correction (true - measured) [m] at every node,
+// a measured position is corrected by trilinear interpolation of the 8 surrounding nodes. Positions outside the grid
+// use the correction at the closest point of the grid.
+//
+// The table is stored cell-major: the 8 corners x 3 axes of every cell are one contiguous block of 24 floats (96 B),
+// so a lookup touches a single block (2 cache lines) instead of 4 rows of the node grid, and consecutive haptic ticks
+// mostly hit the same, already cached, block. The ~8x duplication is cheap for the grid sizes used (< 200 kB).
+//
+// File (plain text, see falcon_calibration):
+//   falcon_correction 1
+//   min <x> <y> <z>
+//   max <x> <y> <z>
+//   size <nx> <ny> <nz>
+//   <dx> <dy> <dz>      one line per node, x fastest, then y, then z
+struct CorrectionSample
+{
+  double measured[3];
+  double truth[3];
+};
+
+struct CorrectionGrid
+{
+  double min[3] {-0.06, -0.06, -0.06};
+  double max[3] {0.06, 0.06, 0.06};
+  int size[3] {9, 9, 9};
+  std::vector<double> nodes;   // 3 per node, x fastest
+
+  int num_nodes() const { return size[0] * size[1] * size[2]; }
+  double node_position(int axis, int k) const { return min[axis] + (max[axis] - min[axis]) * k / (size[axis] - 1); }
+};
+
+class FalconCorrection
+{
+public:
+
+  void configure(const CorrectionGrid & grid)
+  {
+    for (int a=0; a<3; a++) {
+      min_[a] = grid.min[a];
+      n_[a] = std::max(grid.size[a], 2);
+      step_[a] = (grid.max[a] - grid.min[a]) / (n_[a] - 1);
+      inv_step_[a] = 1.0 / step_[a];
+    }
+    cells_.assign((size_t) (n_[0] - 1) * (n_[1] - 1) * (n_[2] - 1) * 24, 0.0f);
+    for (int k=0; k<n_[2]-1; k++) {
+      for (int j=0; j<n_[1]-1; j++) {
+        for (int i=0; i<n_[0]-1; i++) {
+          float * cell = &cells_[cell_index(i, j, k)];
+          for (int c=0; c<8; c++) {
+            int node = ((k + (c >> 2)) * n_[1] + (j + ((c >> 1) & 1))) * n_[0] + (i + (c & 1));
+            for (int a=0; a<3; a++) cell[3*c + a] = (float) grid.nodes[3*node + a];
+          }
+        }
+      }
+    }
+    enabled_ = true;
+  }
+
+  bool load(const std::string & path)
+  {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+    CorrectionGrid grid;
+    std::string key;
+    int version = 0;
+    if (!(file >> key >> version) || key != "falcon_correction" || version != 1) return false;
+    if (!(file >> key >> grid.min[0] >> grid.min[1] >> grid.min[2]) || key != "min") return false;
+    if (!(file >> key >> grid.max[0] >> grid.max[1] >> grid.max[2]) || key != "max") return false;
+    if (!(file >> key >> grid.size[0] >> grid.size[1] >> grid.size[2]) || key != "size") return false;
+    for (int a=0; a<3; a++) if (grid.size[a] < 2 || grid.max[a] <= grid.min[a]) return false;
+    grid.nodes.resize(3 * grid.num_nodes());
+    for (double & v : grid.nodes) if (!(file >> v)) return false;
+    configure(grid);
+    return true;
+  }
+
+  bool enabled() const { return enabled_; }
+
+  // corrects p = {x, y, z} [m] in place, no allocation, ~40 flops
+  void correct(double * p) const
+  {
+    if (!enabled_) return;
+    int idx[3];
+    double w[3];
+    for (int a=0; a<3; a++) {
+      double u = std::clamp((p[a] - min_[a]) * inv_step_[a], 0.0, (double) (n_[a] - 1));
+      idx[a] = std::min((int) u, n_[a] - 2);
+      w[a] = u - idx[a];
+    }
+    const float * cell = &cells_[cell_index(idx[0], idx[1], idx[2])];
+    for (int a=0; a<3; a++) {
+      double c00 = cell[a]      + w[0] * (cell[3 + a]  - cell[a]);
+      double c10 = cell[6 + a]  + w[0] * (cell[9 + a]  - cell[6 + a]);
+      double c01 = cell[12 + a] + w[0] * (cell[15 + a] - cell[12 + a]);
+      double c11 = cell[18 + a] + w[0] * (cell[21 + a] - cell[18 + a]);
+      double c0 = c00 + w[1] * (c10 - c00);
+      double c1 = c01 + w[1] * (c11 - c01);
+      p[a] += c0 + w[2] * (c1 - c0);
+    }
+  }
+
+private:
+
+  size_t cell_index(int i, int j, int k) const { return (((size_t) k * (n_[1] - 1) + j) * (n_[0] - 1) + i) * 24; }
+
+  bool enabled_ {false};
+  double min_[3] {0.0, 0.0, 0.0};
+  double step_[3] {1.0, 1.0, 1.0};
+  double inv_step_[3] {1.0, 1.0, 1.0};
+  int n_[3] {2, 2, 2};
+  std::vector<float> cells_;
+};
+
+
+/////////////////// fitting the grid to calibration samples ///////////////////
+// Every node gets the Gaussian-weighted mean of the sample errors (truth - measured) around it, with a prior
+// of zero correction of weight `regularization`, so nodes far from any sample fade to no correction.
+inline void fit_correction_grid(const std::vector<CorrectionSample> & samples, double kernel_width, double regularization,
+                                CorrectionGrid & grid)
+{
+  grid.nodes.assign(3 * grid.num_nodes(), 0.0);
+  double inv_2s2 = 1.0 / (2 * kernel_width * kernel_width);
+  for (int k=0; k<grid.size[2]; k++) {
+    for (int j=0; j<grid.size[1]; j++) {
+      for (int i=0; i<grid.size[0]; i++) {
+        double node[3] {grid.node_position(0, i), grid.node_position(1, j), grid.node_position(2, k)};
+        double sum_w = regularization;
+        double sum[3] {0.0, 0.0, 0.0};
+        for (const auto & s : samples) {
+          double d2 = 0.0;
+          for (int a=0; a<3; a++) d2 += (s.measured[a] - node[a]) * (s.measured[a] - node[a]);
+          double w = std::exp(-d2 * inv_2s2);
+          sum_w += w;
+          for (int a=0; a<3; a++) sum[a] += w * (s.truth[a] - s.measured[a]);
+        }
+        int n = (k * grid.size[1] + j) * grid.size[0] + i;
+        for (int a=0; a<3; a++) grid.nodes[3*n + a] = (sum_w > 0.0) ? sum[a] / sum_w : 0.0;
+      }
+    }
+  }
+}
+
+inline bool save_correction_grid(const std::string & path, const CorrectionGrid & grid)
+{
+  std::ofstream file(path);
+  if (!file.is_open()) return false;
+  file.precision(8);
+  file << "falcon_correction 1\n";
+  file << "min " << grid.min[0] << " " << grid.min[1] << " " << grid.min[2] << "\n";
+  file << "max " << grid.max[0] << " " << grid.max[1] << " " << grid.max[2] << "\n";
+  file << "size " << grid.size[0] << " " << grid.size[1] << " " << grid.size[2] << "\n";
+  for (int n=0; n<grid.num_nodes(); n++) file << grid.nodes[3*n] << " " << grid.nodes[3*n + 1] << " " << grid.nodes[3*n + 2] << "\n";
+  return file.good();
+}
+
+// "mx my mz tx ty tz" per line [m], lines starting with # are skipped
+inline bool load_correction_samples(const std::string & path, std::vector<CorrectionSample> & samples)
+{
+  std::ifstream file(path);
+  if (!file.is_open()) return false;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::stringstream ss(line);
+    CorrectionSample s;
+    if (ss >> s.measured[0] >> s.measured[1] >> s.measured[2] >> s.truth[0] >> s.truth[1] >> s.truth[2]) samples.push_back(s);
+  }
+  return true;
+}
+
+
+#endif  // CPP_PUBSUB__FALCON_CORRECTION_HPP_
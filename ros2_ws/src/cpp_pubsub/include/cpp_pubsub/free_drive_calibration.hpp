@@ -0,0 +1,150 @@
+#ifndef CPP_PUBSUB__FREE_DRIVE_CALIBRATION_HPP_
+#define CPP_PUBSUB__FREE_DRIVE_CALIBRATION_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "cpp_pubsub/reference_trajectory.hpp"
+
+
+/////////////////// free-drive mapping calibration ///////////////////
+// During a free-drive trial (fully human) every Falcon sample goes into per-axis histograms of position and speed
+// (O(1) per sample, fixed memory). At the end, per axis:
+//   comfortable range  = [low_quantile, high_quantile] of the positions       [cm]
+//   centering          = middle of that range, subtracted from the device     [cm]
+//   comfortable speed  = high_quantile of the speeds                          [cm/s]
+//   gain               = max(gain that makes the comfortable range cover coverage x the reference extent,
+//                            gain that makes the comfortable speed reach the peak reference speed)
+// clamped to [min_gain, max_gain]. Axes the references do not move along keep their default gain (but are centered).
+struct CalibrationSettings
+{
+  double low_quantile {0.05};
+  double high_quantile {0.95};
+  double coverage {1.2};          // comfortable range covers this much of the reference extent
+  double min_gain {1.0};
+  double max_gain {6.0};
+  double device_range {8.0};      // histogram half-width [cm], beyond the Falcon workspace
+  double max_speed {60.0};        // speed histogram range [cm/s]
+  int bins {800};
+  double min_duration {2.0};      // shorter sessions are rejected [s]
+  double min_range {0.5};         // an axis moved less than this is rejected [cm]
+};
+
+struct CalibrationResult
+{
+  bool valid {false};
+  double center[3] {0.0, 0.0, 0.0};
+  double range[3] {0.0, 0.0, 0.0};
+  double speed[3] {0.0, 0.0, 0.0};
+  double gains[3] {0.0, 0.0, 0.0};
+};
+
+class FreeDriveCalibration
+{
+public:
+
+  void configure(const CalibrationSettings & s, double sample_rate)
+  {
+    s_ = s;
+    sample_rate_ = sample_rate;
+    for (int i=0; i<3; i++) {
+      position_hist_[i].assign(s_.bins, 0);
+      speed_hist_[i].assign(s_.bins, 0);
+    }
+    reset();
+  }
+
+  void reset()
+  {
+    n_ = 0;
+    for (int i=0; i<3; i++) {
+      std::fill(position_hist_[i].begin(), position_hist_[i].end(), 0);
+      std::fill(speed_hist_[i].begin(), speed_hist_[i].end(), 0);
+    }
+  }
+
+  // raw device position [cm], one call per Falcon sample
+  void add_sample(const double * device)
+  {
+    for (int i=0; i<3; i++) {
+      position_hist_[i][bin((device[i] + s_.device_range) / (2 * s_.device_range))]++;
+      if (n_ > 0) speed_hist_[i][bin(std::abs(device[i] - prev_[i]) * sample_rate_ / s_.max_speed)]++;
+      prev_[i] = device[i];
+    }
+    n_++;
+  }
+
+  long num_samples() const { return n_; }
+
+  // ref_half_extent [m] and ref_peak_speed [m/s] per axis, over the references the gains have to work for
+  CalibrationResult compute(const double * ref_half_extent, const double * ref_peak_speed, const double * default_gains) const
+  {
+    CalibrationResult r;
+    r.valid = n_ >= s_.min_duration * sample_rate_;
+    for (int i=0; i<3; i++) {
+      double lo = quantile(position_hist_[i], n_, s_.low_quantile) * 2 * s_.device_range - s_.device_range;
+      double hi = quantile(position_hist_[i], n_, s_.high_quantile) * 2 * s_.device_range - s_.device_range;
+      r.center[i] = (lo + hi) / 2;
+      r.range[i] = hi - lo;
+      r.speed[i] = quantile(speed_hist_[i], n_ - 1, s_.high_quantile) * s_.max_speed;
+
+      if (ref_half_extent[i] < 1e-6) {
+        r.gains[i] = default_gains[i];
+        continue;
+      }
+      if (r.range[i] < s_.min_range) r.valid = false;
+      double position_gain = s_.coverage * ref_half_extent[i] * 100 / std::max(r.range[i] / 2, 1e-3);
+      double speed_gain = ref_peak_speed[i] * 100 / std::max(r.speed[i], 1e-3);
+      r.gains[i] = std::clamp(std::max(position_gain, speed_gain), s_.min_gain, s_.max_gain);
+    }
+    return r;
+  }
+
+private:
+
+  int bin(double u) const { return std::clamp((int) (u * s_.bins), 0, s_.bins - 1); }
+
+  // value in [0, 1] (bin center) below which a fraction q of the count samples lie
+  double quantile(const std::vector<long> & hist, long count, double q) const
+  {
+    if (count <= 0) return 0.5;
+    long target = (long) std::ceil(q * count);
+    long sum = 0;
+    for (int k=0; k<(int) hist.size(); k++) {
+      sum += hist[k];
+      if (sum >= target) return (k + 0.5) / hist.size();
+    }
+    return 1.0;
+  }
+
+  CalibrationSettings s_;
+  double sample_rate_ {500.0};
+  std::vector<long> position_hist_[3];
+  std::vector<long> speed_hist_[3];
+  double prev_[3] {0.0, 0.0, 0.0};
+  long n_ {0};
+};
+
+// half extent [m] and peak speed [m/s] per axis over the given references, each traversed in duration [s]
+inline void reference_demands(const std::vector<ReferenceTrajectory> & references, double duration, double * half_extent, double * peak_speed)
+{
+  for (int i=0; i<3; i++) { half_extent[i] = 0.0; peak_speed[i] = 0.0; }
+  for (const auto & reference : references) {
+    int n = reference.num_ticks();
+    double dt = duration / n;
+    for (int i=0; i<3; i++) {
+      double lo = reference.offset_at(0)[i], hi = lo;
+      for (int k=1; k<=n; k++) {
+        double v = reference.offset_at(k)[i];
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+        peak_speed[i] = std::max(peak_speed[i], std::abs(v - reference.offset_at(k-1)[i]) / dt);
+      }
+      half_extent[i] = std::max(half_extent[i], (hi - lo) / 2);
+    }
+  }
+}
+
+
+#endif  // CPP_PUBSUB__FREE_DRIVE_CALIBRATION_HPP_
@@ -0,0 +1,18 @@
+#ifndef CPP_PUBSUB__HRI_TRACE_HPP_
+#define CPP_PUBSUB__HRI_TRACE_HPP_
+
+
+/////////////////// pipeline tracepoints ///////////////////
+// HRI_TRACE(event, args...) emits an LTTng userspace event of the "hri" provider (see hri_tracepoints.h).
+// Without -DHRI_TRACING=ON the macro compiles to nothing; with it, a disabled event costs a single branch.
+// Record with:  lttng create hri && lttng enable-event -u 'hri:*' && lttng start  (then run the nodes)
+// Analyse with: ros2 run cpp_pubsub trace_latency.py ~/lttng-traces/hri-*
+#ifdef HRI_TRACING
+#include "cpp_pubsub/hri_tracepoints.h"
+#define HRI_TRACE(...) tracepoint(hri, __VA_ARGS__)
+#else
+#define HRI_TRACE(...) ((void) 0)
+#endif
+
+
+#endif  // CPP_PUBSUB__HRI_TRACE_HPP_
@@ -0,0 +1,52 @@
+/////////////////// LTTng-UST tracepoint provider for the teleoperation pipeline ///////////////////
+// Only compiled in with -DHRI_TRACING=ON, nodes include cpp_pubsub/hri_trace.hpp instead of this file.
+// Falcon samples are matched across processes by their published (x, y, z) values,
+// controller stages are matched by the controller tick count.
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER hri
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "cpp_pubsub/hri_tracepoints.h"
+
+#if !defined(CPP_PUBSUB__HRI_TRACEPOINTS_H_) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define CPP_PUBSUB__HRI_TRACEPOINTS_H_
+
+#include <stdint.h>
+#include <lttng/tracepoint.h>
+
+// position_talker: device read and publish of the same sample
+TRACEPOINT_EVENT(hri, falcon_read,
+  TP_ARGS(int64_t, seq),
+  TP_FIELDS(ctf_integer(int64_t, seq, seq)))
+
+TRACEPOINT_EVENT(hri, falcon_publish,
+  TP_ARGS(int64_t, seq, double, x, double, y, double, z),
+  TP_FIELDS(ctf_integer(int64_t, seq, seq) ctf_float(double, x, x) ctf_float(double, y, y) ctf_float(double, z, z)))
+
+// real_controller: falcon sample arrives
+TRACEPOINT_EVENT(hri, falcon_receive,
+  TP_ARGS(double, x, double, y, double, z),
+  TP_FIELDS(ctf_float(double, x, x) ctf_float(double, y, y) ctf_float(double, z, z)))
+
+// real_controller: one control tick
+TRACEPOINT_EVENT(hri, ik_start,
+  TP_ARGS(int64_t, tick),
+  TP_FIELDS(ctf_integer(int64_t, tick, tick)))
+
+TRACEPOINT_EVENT(hri, ik_end,
+  TP_ARGS(int64_t, tick),
+  TP_FIELDS(ctf_integer(int64_t, tick, tick)))
+
+TRACEPOINT_EVENT(hri, command_publish,
+  TP_ARGS(int64_t, tick),
+  TP_FIELDS(ctf_integer(int64_t, tick, tick)))
+
+// real_controller: robot state arrives
+TRACEPOINT_EVENT(hri, joint_state_receive,
+  TP_ARGS(int64_t, seq),
+  TP_FIELDS(ctf_integer(int64_t, seq, seq)))
+
+#endif  // CPP_PUBSUB__HRI_TRACEPOINTS_H_
+
+#include <lttng/tracepoint-event.h>
@@ -0,0 +1,199 @@
+#ifndef CPP_PUBSUB__INPUT_FILTERS_HPP_
+#define CPP_PUBSUB__INPUT_FILTERS_HPP_
+
+#include <cmath>
+
+
+/////////////////// low-latency, allocation-free single-axis filters ///////////////////
+// every filter reports its group delay at low frequencies [s], i.e. how far the output lags
+// behind an input moving at constant velocity
+
+enum class FilterType { none = 0, one_euro = 1, second_order = 2, kalman = 3 };
+
+struct FilterSettings
+{
+  FilterType type {FilterType::none};
+
+  // One-Euro: cutoff = min_cutoff + beta * |speed|
+  double min_cutoff {2.0};      // [Hz]
+  double beta {50.0};           // [1/m]
+  double d_cutoff {1.0};        // cutoff of the speed estimate [Hz]
+
+  // critically damped second-order low-pass
+  double natural_freq {20.0};   // [Hz]
+
+  // constant-velocity Kalman filter
+  double process_noise {0.5};        // acceleration noise density [(m/s^2)^2 s]
+  double measurement_noise {4e-10};  // position noise variance [m^2]
+};
+
+inline double smoothing_factor(double cutoff, double dt)
+{
+  double tau = 1.0 / (2 * M_PI * cutoff);
+  return 1.0 / (1.0 + tau / dt);
+}
+
+
+/////////////////// One-Euro filter (Casiez et al., 2012) ///////////////////
+class OneEuroFilter
+{
+public:
+
+  void reset() { initialized_ = false; }
+
+  double filter(double x, double dt, const FilterSettings & s)
+  {
+    if (!initialized_) {
+      x_ = x;
+      dx_ = 0.0;
+      cutoff_ = s.min_cutoff;
+      initialized_ = true;
+      return x_;
+    }
+    double a_d = smoothing_factor(s.d_cutoff, dt);
+    dx_ = a_d * (x - x_) / dt + (1.0 - a_d) * dx_;
+
+    cutoff_ = s.min_cutoff + s.beta * std::abs(dx_);
+    double a = smoothing_factor(cutoff_, dt);
+    x_ = a * x + (1.0 - a) * x_;
+    return x_;
+  }
+
+  // first-order low-pass at the current (speed dependent) cutoff
+  double group_delay() const { return 1.0 / (2 * M_PI * cutoff_); }
+
+private:
+
+  bool initialized_ {false};
+  double x_ {0.0};
+  double dx_ {0.0};
+  double cutoff_ {1.0};
+};
+
+
+/////////////////// critically damped second-order low-pass ///////////////////
+// x'' = w0^2 (u - x) - 2 w0 x', integrated with semi-implicit Euler
+class CriticallyDampedFilter
+{
+public:
+
+  void reset() { initialized_ = false; }
+
+  double filter(double u, double dt, const FilterSettings & s)
+  {
+    w0_ = 2 * M_PI * s.natural_freq;
+    if (!initialized_) {
+      x_ = u;
+      v_ = 0.0;
+      initialized_ = true;
+      return x_;
+    }
+    double acc = w0_ * w0_ * (u - x_) - 2.0 * w0_ * v_;
+    v_ += acc * dt;
+    x_ += v_ * dt;
+    return x_;
+  }
+
+  // 2 * zeta / w0 with zeta = 1
+  double group_delay() const { return 2.0 / w0_; }
+
+private:
+
+  bool initialized_ {false};
+  double x_ {0.0};
+  double v_ {0.0};
+  double w0_ {1.0};
+};
+
+
+/////////////////// constant-velocity Kalman filter ///////////////////
+// state {position, velocity}, measurement = position, 2x2 covariance kept in plain doubles
+class KalmanFilterCV
+{
+public:
+
+  void reset() { initialized_ = false; }
+
+  double filter(double z, double dt, const FilterSettings & s)
+  {
+    if (!initialized_) {
+      x_ = z;
+      v_ = 0.0;
+      p00_ = s.measurement_noise; p01_ = 0.0; p11_ = 1.0;
+      initialized_ = true;
+      return x_;
+    }
+    // predict
+    x_ += v_ * dt;
+    double q = s.process_noise;
+    double p00 = p00_ + dt * (2.0 * p01_ + dt * p11_) + q * dt * dt * dt / 3.0;
+    double p01 = p01_ + dt * p11_ + q * dt * dt / 2.0;
+    double p11 = p11_ + q * dt;
+
+    // update
+    double k0 = p00 / (p00 + s.measurement_noise);
+    double k1 = p01 / (p00 + s.measurement_noise);
+    double r = z - x_;
+    x_ += k0 * r;
+    v_ += k1 * r;
+    p00_ = (1.0 - k0) * p00;
+    p01_ = (1.0 - k0) * p01;
+    p11_ = p11 - k1 * p01;
+    return x_;
+  }
+
+  // the velocity state removes the lag for constant-velocity motion
+  double group_delay() const { return 0.0; }
+
+private:
+
+  bool initialized_ {false};
+  double x_ {0.0};
+  double v_ {0.0};
+  double p00_ {0.0};
+  double p01_ {0.0};
+  double p11_ {0.0};
+};
+
+
+/////////////////// one axis of the configured filter stage ///////////////////
+class AxisFilter
+{
+public:
+
+  void reset()
+  {
+    one_euro_.reset();
+    second_order_.reset();
+    kalman_.reset();
+  }
+
+  double filter(double x, double dt, const FilterSettings & s)
+  {
+    switch (s.type) {
+      case FilterType::one_euro:     return one_euro_.filter(x, dt, s);
+      case FilterType::second_order: return second_order_.filter(x, dt, s);
+      case FilterType::kalman:       return kalman_.filter(x, dt, s);
+      default:                       return x;
+    }
+  }
+
+  double group_delay(const FilterSettings & s) const
+  {
+    switch (s.type) {
+      case FilterType::one_euro:     return one_euro_.group_delay();
+      case FilterType::second_order: return second_order_.group_delay();
+      case FilterType::kalman:       return kalman_.group_delay();
+      default:                       return 0.0;
+    }
+  }
+
+private:
+
+  OneEuroFilter one_euro_;
+  CriticallyDampedFilter second_order_;
+  KalmanFilterCV kalman_;
+};
+
+
+#endif  // CPP_PUBSUB__INPUT_FILTERS_HPP_
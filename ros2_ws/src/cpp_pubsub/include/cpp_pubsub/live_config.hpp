@@ -0,0 +1,104 @@
+#ifndef CPP_PUBSUB__LIVE_CONFIG_HPP_
+#define CPP_PUBSUB__LIVE_CONFIG_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/////////////////// live configuration swapping ///////////////////
+// Parameter changes are turned into a complete, immutable-once-published configuration by a worker thread,
+// the control thread picks it up with a single atomic load per tick (never locks, never waits for a build).
+// Requests that arrive while a build is running are coalesced, only the latest one is built next.
+// Published configurations are kept alive until shutdown, the control thread may still be using any of them
+// (parameter changes are rare, each configuration is a few hundred kB at most).
+template<typename ParamsT, typename ConfigT>
+class LiveConfig
+{
+public:
+
+  using Builder = std::function<std::unique_ptr<ConfigT>(const ParamsT &)>;
+
+  ~LiveConfig() { stop(); }
+
+  void start(Builder builder)
+  {
+    builder_ = builder;
+    running_ = true;
+    worker_ = std::thread([this]() { worker_loop(); });
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    cv_.notify_one();
+    if (worker_.joinable()) worker_.join();
+  }
+
+  // synchronous build & publish (initial configuration, before the control loop runs)
+  ConfigT * build_now(const ParamsT & params)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return publish(builder_(params));
+  }
+
+  // any thread, returns immediately, the configuration is built on the worker thread
+  void request(const ParamsT & params)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      requested_ = std::make_unique<ParamsT>(params);
+    }
+    cv_.notify_one();
+  }
+
+  // control thread: the newest published configuration if it differs from the active one, else nullptr
+  ConfigT * poll(const ConfigT * active) const
+  {
+    ConfigT * latest = latest_.load(std::memory_order_acquire);
+    return latest != active ? latest : nullptr;
+  }
+
+private:
+
+  void worker_loop()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this]() { return !running_ || requested_ != nullptr; });
+      if (!running_) return;
+      std::unique_ptr<ParamsT> params = std::move(requested_);
+      lock.unlock();
+      std::unique_ptr<ConfigT> config = builder_(*params);   // the slow part, outside the lock
+      lock.lock();
+      if (config) publish(std::move(config));
+    }
+  }
+
+  // called with mutex_ held
+  ConfigT * publish(std::unique_ptr<ConfigT> config)
+  {
+    pool_.push_back(std::move(config));
+    latest_.store(pool_.back().get(), std::memory_order_release);
+    return pool_.back().get();
+  }
+
+  Builder builder_;
+  std::thread worker_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_ {false};
+  std::unique_ptr<ParamsT> requested_;
+  std::vector<std::unique_ptr<ConfigT>> pool_;
+  std::atomic<ConfigT *> latest_ {nullptr};
+};
+
+
+#endif  // CPP_PUBSUB__LIVE_CONFIG_HPP_
@@ -0,0 +1,134 @@
+#ifndef CPP_PUBSUB__MOTION_SCALING_HPP_
+#define CPP_PUBSUB__MOTION_SCALING_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+/////////////////// Falcon -> robot motion scaling ///////////////////
+// mapping modes:
+//   0 uniform  -> robot = mapping_ratio * device (the original mapping)
+//   1 per_axis -> robot = axis_gains[i] * device[i]
+// modes 1-3 use axis_gains only when they are set (parameter or free-drive calibration), otherwise every axis gets
+// mapping_ratio, so a live mapping_ratio change applies to them too
+//   2 prism    -> velocity-dependent scaling (PRISM, Frees & Kessler 2005): slow device motion is scaled down
+//                 for precision, fast motion uses the full gain and recovers the accumulated offset
+//   3 lookup   -> robot = axis_gains[i] * f(device[i]) with a precomputed, linearly interpolated shaping curve
+//                 f(x) = sign(x) * range * (|x| / range)^lut_exponent (exponent > 1 = finer near the center)
+enum class MappingMode { uniform = 0, per_axis = 1, prism = 2, lookup = 3 };
+
+struct MappingSettings
+{
+  MappingMode mode {MappingMode::uniform};
+  double mapping_ratio {3.0};
+  double axis_gains[3] {3.0, 3.0, 3.0};
+  bool axis_gains_set {false};
+  double device_center[3] {0.0, 0.0, 0.0};   // subtracted from the device position first [cm], see free_drive_calibration.hpp
+
+  double prism_min_speed {0.5};     // below this device speed the gain is scaled down linearly [cm/s]
+  double prism_max_speed {5.0};     // above this device speed the full gain is used [cm/s]
+  double prism_min_scale {0.2};     // scale applied at (and below) prism_min_speed
+  double prism_recovery {2.0};      // offset recovery rate at full speed [1/s]
+
+  double lut_exponent {1.5};
+  double lut_range {5.0};           // half-width of the shaping curve [cm], beyond it the curve continues linearly
+  int lut_size {513};
+};
+
+class MotionScaling
+{
+public:
+
+  void configure(const MappingSettings & s)
+  {
+    s_ = s;
+    if (s_.mode == MappingMode::uniform || !s_.axis_gains_set) for (int i=0; i<3; i++) s_.axis_gains[i] = s_.mapping_ratio;
+    initialized_ = false;
+
+    // shaping curve on a uniform grid over [-range, range]
+    if (s_.mode == MappingMode::lookup) {
+      int n = std::max(s_.lut_size, 3);
+      lut_.resize(n);
+      lut_step_ = 2 * s_.lut_range / (n - 1);
+      for (int k=0; k<n; k++) {
+        double x = -s_.lut_range + k * lut_step_;
+        lut_.at(k) = std::copysign(s_.lut_range * std::pow(std::abs(x) / s_.lut_range, s_.lut_exponent), x);
+      }
+      lut_edge_slope_ = s_.lut_exponent;   // f'(range) = exponent
+    }
+  }
+
+  // device in [cm], dt = time since the previous device sample in [s], writes the robot-frame offset in [m]
+  void map(const double * raw_device, double dt, double * mapped)
+  {
+    double device[3];
+    for (int i=0; i<3; i++) device[i] = raw_device[i] - s_.device_center[i];
+    switch (s_.mode) {
+      case MappingMode::prism:
+        map_prism(device, dt, mapped);
+        break;
+      case MappingMode::lookup:
+        for (int i=0; i<3; i++) mapped[i] = s_.axis_gains[i] * shape(device[i]) / 100;
+        break;
+      default:
+        for (int i=0; i<3; i++) mapped[i] = s_.axis_gains[i] * device[i] / 100;
+        break;
+    }
+  }
+
+private:
+
+  double shape(double x) const
+  {
+    if (x >= s_.lut_range) return lut_.back() + (x - s_.lut_range) * lut_edge_slope_;
+    if (x <= -s_.lut_range) return lut_.front() + (x + s_.lut_range) * lut_edge_slope_;
+    double pos = (x + s_.lut_range) / lut_step_;
+    int k = std::min((int) pos, (int) lut_.size() - 2);
+    double mu = pos - k;
+    return lut_[k] + mu * (lut_[k+1] - lut_[k]);
+  }
+
+  void map_prism(const double * device, double dt, double * mapped)
+  {
+    if (!initialized_) {
+      for (int i=0; i<3; i++) {
+        prev_device_[i] = device[i];
+        state_[i] = s_.axis_gains[i] * device[i] / 100;
+      }
+      initialized_ = true;
+    }
+    for (int i=0; i<3; i++) {
+      double delta = device[i] - prev_device_[i];
+      prev_device_[i] = device[i];
+      double speed = std::abs(delta) / dt;
+
+      double scale = 1.0;
+      if (speed < s_.prism_max_speed) {
+        double mu = std::clamp((speed - s_.prism_min_speed) / (s_.prism_max_speed - s_.prism_min_speed), 0.0, 1.0);
+        scale = s_.prism_min_scale + mu * (1.0 - s_.prism_min_scale);
+      }
+      state_[i] += scale * s_.axis_gains[i] * delta / 100;
+
+      // at full speed, pull the incremental target back towards the absolute mapping
+      if (scale >= 1.0) {
+        double absolute = s_.axis_gains[i] * device[i] / 100;
+        state_[i] += (absolute - state_[i]) * std::min(s_.prism_recovery * dt, 1.0);
+      }
+      mapped[i] = state_[i];
+    }
+  }
+
+  MappingSettings s_;
+
+  std::vector<double> lut_ {0.0, 0.0};
+  double lut_step_ {1.0};
+  double lut_edge_slope_ {1.0};
+
+  bool initialized_ {false};
+  double prev_device_[3] {0.0, 0.0, 0.0};
+  double state_[3] {0.0, 0.0, 0.0};
+};
+
+
+#endif  // CPP_PUBSUB__MOTION_SCALING_HPP_
@@ -0,0 +1,78 @@
+#ifndef CPP_PUBSUB__PARTICIPANT_STORE_HPP_
+#define CPP_PUBSUB__PARTICIPANT_STORE_HPP_
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/////////////////// per-participant persistent state ///////////////////
+// one plain-text file per participant, <dir>/part_<part_id>.txt, one "key v1 v2 ..." entry per line
+class ParticipantStore
+{
+public:
+
+  ParticipantStore(const std::string & dir, int part_id)
+  : path_(dir + "part_" + std::to_string(part_id) + ".txt") {}
+
+  // returns false if there is no state for this participant yet
+  bool load()
+  {
+    std::ifstream file(path_);
+    if (!file.is_open()) return false;
+
+    entries_.clear();
+    std::string line;
+    while (getline(file, line)) {
+      std::stringstream ss(line);
+      std::string key;
+      if (!(ss >> key)) continue;
+      std::vector<double> vals;
+      double v;
+      while (ss >> v) vals.push_back(v);
+      entries_[key] = vals;
+    }
+    return true;
+  }
+
+  // write to a temporary file first, so a crash never leaves a half-written state file behind
+  bool save() const
+  {
+    std::string tmp_path = path_ + ".tmp";
+    {
+      std::ofstream file(tmp_path);
+      if (!file.is_open()) return false;
+      file.precision(10);
+      for (const auto & entry : entries_) {
+        file << entry.first;
+        for (double v : entry.second) file << " " << v;
+        file << "\n";
+      }
+      if (!file.good()) return false;
+    }
+    return std::rename(tmp_path.c_str(), path_.c_str()) == 0;
+  }
+
+  bool get(const std::string & key, std::vector<double> & vals) const
+  {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) return false;
+    vals = it->second;
+    return true;
+  }
+
+  void set(const std::string & key, const std::vector<double> & vals) { entries_[key] = vals; }
+
+  const std::string & path() const { return path_; }
+
+private:
+
+  std::string path_;
+  std::map<std::string, std::vector<double>> entries_;
+};
+
+
+#endif  // CPP_PUBSUB__PARTICIPANT_STORE_HPP_
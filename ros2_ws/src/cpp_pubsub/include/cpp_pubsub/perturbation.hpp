@@ -0,0 +1,132 @@
+#ifndef CPP_PUBSUB__PERTURBATION_HPP_
+#define CPP_PUBSUB__PERTURBATION_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+
+/////////////////// robot perturbations ///////////////////
+// 10 channels: {x, y, z} Cartesian offsets of the robot target in [m], then the 7 joints in [rad].
+// Every channel is precomputed for every tick of the trial into one contiguous tick-major table,
+// so applying it costs one pointer lookup and a few adds per tick.
+//
+// Spectral noise = sum of sinusoids, log-spaced over [f_low, f_high] with random phases and a power
+// spectral density proportional to 1/f^exponent (0 = flat, 1 = pink, 2 = brown), normalized to unit RMS
+// and scaled by the channel amplitude. A correlation rho in [0, 1] mixes a source shared by all channels
+// into each one, giving a pairwise correlation of about rho between channels with the same exponent.
+constexpr int num_cartesian_channels = 3;
+constexpr int num_joint_channels = 7;
+constexpr int num_perturbation_channels = num_cartesian_channels + num_joint_channels;
+
+enum class EnvelopeType { constant = 0, ramp_in_out = 1, increasing = 2, decreasing = 3 };
+
+struct PerturbationSettings
+{
+  double amplitude[num_perturbation_channels] {};   // RMS, 0 disables the channel
+  double exponent[num_perturbation_channels] {};
+  double f_low {0.1};       // in [Hz]
+  double f_high {1.0};      // in [Hz]
+  double correlation {0.0};
+  EnvelopeType envelope {EnvelopeType::ramp_in_out};
+  double ramp_fraction {0.1};   // ramp_in_out: fraction of the trial faded in / out
+  unsigned int seed {0};
+  int num_components {64};
+};
+
+// amplitude envelope over the trial, u in [0, 1]
+inline double envelope_value(const PerturbationSettings & s, double u)
+{
+  switch (s.envelope) {
+    case EnvelopeType::constant:   return 1.0;
+    case EnvelopeType::increasing: return u;
+    case EnvelopeType::decreasing: return 1.0 - u;
+    case EnvelopeType::ramp_in_out: {
+      double r = std::max(s.ramp_fraction, 1e-6);
+      double e = std::min({1.0, u / r, (1.0 - u) / r});
+      return 0.5 - 0.5 * std::cos(M_PI * std::clamp(e, 0.0, 1.0));
+    }
+  }
+  return 1.0;
+}
+
+class PerturbationTable
+{
+public:
+
+  // num_ticks + 1 rows at tick_rate [Hz]
+  void build(const PerturbationSettings & s, int num_ticks, double tick_rate)
+  {
+    num_ticks_ = std::max(num_ticks, 1);
+    table_.assign((num_ticks_ + 1) * num_perturbation_channels, 0.0);
+    joints_active_ = false;
+
+    std::mt19937 rng(s.seed);
+    std::uniform_real_distribution<double> phase_dist(0.0, 2 * M_PI);
+    int n = std::max(s.num_components, 1);
+    double f_low = std::max(s.f_low, 1e-3);
+    double f_high = std::max(s.f_high, f_low);
+
+    // log-spaced component frequencies and the bandwidth each one stands for
+    std::vector<double> freq(n), width(n);
+    for (int k=0; k<n; k++) freq[k] = f_low * std::pow(f_high / f_low, n > 1 ? (double) k / (n - 1) : 0.0);
+    for (int k=0; k<n; k++) width[k] = (n > 1) ? (freq[std::min(k+1, n-1)] - freq[std::max(k-1, 0)]) / 2 : 1.0;
+
+    std::vector<double> shared_phase(n);
+    for (int k=0; k<n; k++) shared_phase[k] = phase_dist(rng);
+    double rho = std::clamp(s.correlation, 0.0, 1.0);
+
+    std::vector<double> signal(num_ticks_ + 1);
+    for (int c=0; c<num_perturbation_channels; c++) {
+      std::vector<double> own_phase(n);
+      for (int k=0; k<n; k++) own_phase[k] = phase_dist(rng);   // drawn for every channel, so enabling one never changes the others
+      if (s.amplitude[c] == 0.0) continue;
+      if (c >= num_cartesian_channels) joints_active_ = true;
+
+      std::vector<double> gain(n);
+      for (int k=0; k<n; k++) gain[k] = std::sqrt(width[k] * std::pow(freq[k], -s.exponent[c]));
+
+      double sum_sq = 0.0;
+      for (int j=0; j<=num_ticks_; j++) {
+        double t = j / tick_rate;
+        double shared = 0.0, own = 0.0;
+        for (int k=0; k<n; k++) {
+          double w = 2 * M_PI * freq[k] * t;
+          shared += gain[k] * std::sin(w + shared_phase[k]);
+          own += gain[k] * std::sin(w + own_phase[k]);
+        }
+        signal[j] = std::sqrt(rho) * shared + std::sqrt(1.0 - rho) * own;
+        sum_sq += signal[j] * signal[j];
+      }
+      double scale = s.amplitude[c] / std::sqrt(std::max(sum_sq / (num_ticks_ + 1), 1e-12));
+      for (int j=0; j<=num_ticks_; j++) {
+        table_[j * num_perturbation_channels + c] = scale * signal[j] * envelope_value(s, (double) j / num_ticks_);
+      }
+    }
+  }
+
+  // legacy: a single precomputed channel (e.g. the z noise csv files)
+  void build_from_channel(int channel, const std::vector<double> & values, int num_ticks)
+  {
+    num_ticks_ = std::max(num_ticks, 1);
+    table_.assign((num_ticks_ + 1) * num_perturbation_channels, 0.0);
+    joints_active_ = channel >= num_cartesian_channels;
+    for (int j=0; j<=num_ticks_ && j<(int) values.size(); j++) table_[j * num_perturbation_channels + channel] = values[j];
+  }
+
+  // the 10 channel values of a tick, clamped to the trial
+  const double * at(int tick) const { return &table_[std::clamp(tick, 0, num_ticks_) * num_perturbation_channels]; }
+
+  bool joints_active() const { return joints_active_; }
+  int num_ticks() const { return num_ticks_; }
+
+private:
+
+  std::vector<double> table_ = std::vector<double>(2 * num_perturbation_channels, 0.0);
+  int num_ticks_ {1};
+  bool joints_active_ {false};
+};
+
+
+#endif  // CPP_PUBSUB__PERTURBATION_HPP_
@@ -0,0 +1,197 @@
+#ifndef CPP_PUBSUB__PHASE_TRACE_HPP_
+#define CPP_PUBSUB__PHASE_TRACE_HPP_
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+/////////////////// per-tick phase timings ///////////////////
+// Every controller tick records one span per phase into a fixed-size ring (no allocation after reserve()),
+// so the last few seconds are always available and can be written out as a Chrome / Perfetto trace
+// (open the json in chrome://tracing or ui.perfetto.dev) when a deadline is missed.
+enum class TickPhase { control = 0, ik = 1, publish = 2, logging = 3 };
+constexpr int num_tick_phases = 4;
+
+inline const char * phase_name(TickPhase phase)
+{
+  switch (phase) {
+    case TickPhase::control: return "control law";
+    case TickPhase::ik:      return "IK";
+    case TickPhase::publish: return "publish";
+    case TickPhase::logging: return "logging";
+  }
+  return "unknown";
+}
+
+struct PhaseSpan
+{
+  long tick;
+  TickPhase phase;
+  int64_t start_ns;   // monotonic time since the controller epoch
+  int64_t end_ns;
+};
+
+class PhaseTraceRing
+{
+public:
+
+  void reserve(size_t capacity)
+  {
+    spans_.assign(capacity, PhaseSpan{0, TickPhase::control, 0, 0});
+    head_ = 0;
+    size_ = 0;
+  }
+
+  void record(long tick, TickPhase phase, int64_t start_ns, int64_t end_ns)
+  {
+    if (spans_.empty()) return;
+    spans_[head_] = PhaseSpan{tick, phase, start_ns, end_ns};
+    head_ = (head_ + 1) % spans_.size();
+    if (size_ < spans_.size()) size_++;
+  }
+
+  // k-th span, oldest first
+  const PhaseSpan & at(size_t k) const
+  {
+    size_t first = (head_ + spans_.size() - size_) % std::max<size_t>(spans_.size(), 1);
+    return spans_[(first + k) % spans_.size()];
+  }
+
+  // exchanges the storage with another ring (O(1), no copy)
+  void swap(PhaseTraceRing & other)
+  {
+    spans_.swap(other.spans_);
+    std::swap(head_, other.head_);
+    std::swap(size_, other.size_);
+  }
+
+  void clear()
+  {
+    head_ = 0;
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return spans_.size(); }
+
+private:
+
+  std::vector<PhaseSpan> spans_;
+  size_t head_ {0};
+  size_t size_ {0};
+};
+
+// Chrome trace event format: complete events ("X") for the phases, instant events ("i") for the markers
+inline bool write_chrome_trace(const std::string & path, const PhaseTraceRing & spans,
+                               const std::vector<std::pair<int64_t, std::string>> & markers)
+{
+  std::ofstream file(path);
+  if (!file.is_open()) return false;
+  file.precision(15);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"real_controller tick\"}}";
+  for (size_t k=0; k<spans.size(); k++) {
+    const PhaseSpan & s = spans.at(k);
+    file << ",\n{\"name\":\"" << phase_name(s.phase) << "\",\"cat\":\"tick\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+         << ",\"ts\":" << s.start_ns / 1000.0 << ",\"dur\":" << (s.end_ns - s.start_ns) / 1000.0
+         << ",\"args\":{\"tick\":" << s.tick << "}}";
+  }
+  for (const auto & m : markers) {
+    file << ",\n{\"name\":\"" << m.second << "\",\"cat\":\"marker\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":1"
+         << ",\"ts\":" << m.first / 1000.0 << "}";
+  }
+  file << "\n]}\n";
+  return file.good();
+}
+
+
+/////////////////// background trace writer ///////////////////
+// A long-lived writer thread at normal (SCHED_OTHER) priority owns a spare ring of the same capacity. A dump swaps
+// the live ring and markers with the spare ones (O(1), no copy, no allocation, no thread creation on the control
+// thread) and wakes the writer; the live ring starts over empty. A dump requested while the previous one is still
+// being written is dropped.
+class PhaseTraceWriter
+{
+public:
+
+  ~PhaseTraceWriter() { stop(); }
+
+  void start(size_t span_capacity, size_t marker_capacity)
+  {
+    spare_.reserve(span_capacity);
+    spare_markers_.reserve(marker_capacity);
+    running_ = true;
+    writer_ = std::thread([this]() { write_loop(); });
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    cv_.notify_one();
+    if (writer_.joinable()) writer_.join();
+  }
+
+  // control thread: hands the ring and markers over, returns false (and leaves them alone) if the writer is busy
+  bool request(PhaseTraceRing & ring, std::vector<std::pair<int64_t, std::string>> & markers, const char * path)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+      if (!lock.owns_lock() || pending_ || !running_) return false;
+      ring.swap(spare_);
+      ring.clear();
+      markers.swap(spare_markers_);
+      markers.clear();
+      std::snprintf(path_, sizeof(path_), "%s", path);
+      pending_ = true;
+    }
+    cv_.notify_one();
+    return true;
+  }
+
+private:
+
+  void write_loop()
+  {
+    // never inherit the control thread's real-time class
+    sched_param param {};
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this]() { return pending_ || !running_; });
+      if (!pending_) return;
+      lock.unlock();
+      if (write_chrome_trace(path_, spare_, spare_markers_)) std::cout << "Phase trace written to " << path_ << std::endl;
+      else std::cout << "Could not write the phase trace to " << path_ << std::endl;
+      lock.lock();
+      pending_ = false;
+    }
+  }
+
+  PhaseTraceRing spare_;
+  std::vector<std::pair<int64_t, std::string>> spare_markers_;
+  char path_[512] {};
+  bool pending_ {false};
+  bool running_ {false};
+  std::thread writer_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+
+#endif  // CPP_PUBSUB__PHASE_TRACE_HPP_
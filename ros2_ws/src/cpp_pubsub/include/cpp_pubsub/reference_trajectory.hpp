@@ -0,0 +1,118 @@
+#ifndef CPP_PUBSUB__REFERENCE_TRAJECTORY_HPP_
+#define CPP_PUBSUB__REFERENCE_TRAJECTORY_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+/////////////////// sine-sum reference curve ///////////////////
+// z = (ph * height) * (sin(pa (t+ps)) + sin(pb (t+ps)) + sin(pc (t+ps))), t = [0, 2pi]
+struct SineSumParams
+{
+  int pa {0};
+  int pb {0};
+  int pc {0};
+  double ps {0.0};
+  double ph {0.0};
+
+  double depth {0.1};
+  double width {0.3};
+  double height {0.1};
+  int use_depth {0};
+};
+
+// write the sine curve parameters for the given traj_id, returns false for an unknown id
+inline bool get_sine_sum_params(int traj_id, SineSumParams & p)
+{
+  switch (traj_id) {
+    case 0: p.pa = 1; p.pb = 1; p.pc = 4; p.ps = M_PI;     p.ph = 0.25; return true;
+    case 1: p.pa = 2; p.pb = 3; p.pc = 4; p.ps = 4*M_PI/3; p.ph = 0.25; return true;
+    case 2: p.pa = 1; p.pb = 3; p.pc = 4; p.ps = M_PI;     p.ph = 0.25; return true;
+    case 3: p.pa = 2; p.pb = 2; p.pc = 5; p.ps = M_PI;     p.ph = 0.2;  return true;
+    case 4: p.pa = 2; p.pb = 3; p.pc = 5; p.ps = 8*M_PI/5; p.ph = 0.2;  return true;
+    case 5: p.pa = 2; p.pb = 4; p.pc = 5; p.ps = M_PI;     p.ph = 0.2;  return true;
+  }
+  return false;
+}
+
+// offset from the task-space origin at curve parameter t
+inline void sine_sum_offset(const SineSumParams & p, double t, double * xyz)
+{
+  xyz[0] = 0.0;
+  if (p.use_depth) xyz[0] = std::abs(t-M_PI) / M_PI * p.depth - (p.depth/2);
+  xyz[1] = t / (2*M_PI) * p.width - (p.width/2);
+  xyz[2] = (p.ph*p.height) * (std::sin(p.pa*(t+p.ps)) + std::sin(p.pb*(t+p.ps)) + std::sin(p.pc*(t+p.ps)));
+}
+
+
+/////////////////// per-tick reference table ///////////////////
+// Samples a curve t = [0, 2pi] -> offset once at startup, so the control loop only does a table lookup.
+// With arc_length = true the curve is reparameterized by arc length, i.e. the reference moves at the
+// constant speed length() / duration instead of advancing linearly in t.
+class ReferenceTrajectory
+{
+public:
+
+  // curve must be callable as curve(double t, double * xyz)
+  template<typename Curve>
+  void build(Curve curve, int num_ticks, bool arc_length, int num_length_samples = 20000)
+  {
+    if (num_ticks < 1) num_ticks = 1;
+    if (num_length_samples < num_ticks) num_length_samples = num_ticks;
+
+    // cumulative length table on a fine, uniform grid in t
+    std::vector<double> cum_length(num_length_samples + 1, 0.0);
+    double prev[3];
+    double curr[3];
+    curve(0.0, prev);
+    for (int i=1; i<=num_length_samples; i++) {
+      curve((double) i / num_length_samples * 2 * M_PI, curr);
+      double dx = curr[0] - prev[0];
+      double dy = curr[1] - prev[1];
+      double dz = curr[2] - prev[2];
+      cum_length.at(i) = cum_length.at(i-1) + std::sqrt(dx*dx + dy*dy + dz*dz);
+      for (int j=0; j<3; j++) prev[j] = curr[j];
+    }
+    length_ = cum_length.back();
+
+    // curve parameter per tick
+    t_table_.resize(num_ticks + 1);
+    if (!arc_length || length_ <= 0.0) {
+      for (int k=0; k<=num_ticks; k++) t_table_.at(k) = (double) k / num_ticks * 2 * M_PI;
+    } else {
+      // inverse lookup s -> t, the targets s_k are increasing so a single forward sweep is enough
+      int i = 0;
+      for (int k=0; k<=num_ticks; k++) {
+        double s = (double) k / num_ticks * length_;
+        while (i < num_length_samples - 1 && cum_length.at(i+1) < s) i++;
+        double seg = cum_length.at(i+1) - cum_length.at(i);
+        double mu = (seg > 0.0) ? (s - cum_length.at(i)) / seg : 0.0;
+        mu = std::clamp(mu, 0.0, 1.0);
+        t_table_.at(k) = ((double) i + mu) / num_length_samples * 2 * M_PI;
+      }
+    }
+
+    // offsets per tick, stored as contiguous {x, y, z} triplets
+    xyz_table_.resize(3 * (num_ticks + 1));
+    for (int k=0; k<=num_ticks; k++) curve(t_table_.at(k), &xyz_table_.at(3*k));
+  }
+
+  int num_ticks() const { return (int) t_table_.size() - 1; }
+  double length() const { return length_; }
+
+  // tick is clamped to [0, num_ticks]
+  double t_at(int tick) const { return t_table_.at(clamp_tick(tick)); }
+  const double * offset_at(int tick) const { return &xyz_table_.at(3 * clamp_tick(tick)); }
+
+private:
+
+  int clamp_tick(int tick) const { return std::clamp(tick, 0, num_ticks()); }
+
+  std::vector<double> t_table_ {0.0};
+  std::vector<double> xyz_table_ {0.0, 0.0, 0.0};
+  double length_ {0.0};
+};
+
+
+#endif  // CPP_PUBSUB__REFERENCE_TRAJECTORY_HPP_
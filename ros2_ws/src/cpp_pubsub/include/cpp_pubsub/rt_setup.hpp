@@ -0,0 +1,114 @@
+#ifndef CPP_PUBSUB__RT_SETUP_HPP_
+#define CPP_PUBSUB__RT_SETUP_HPP_
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/////////////////// real-time placement of a node ///////////////////
+// The launch profile pins the whole process with a taskset prefix (so the middleware threads follow),
+// the node then switches its own (executor) thread to SCHED_FIFO, locks its memory and checks what
+// was actually granted: missing CAP_SYS_NICE / rtprio / memlock limits only show up here.
+struct RtSettings
+{
+  std::vector<int> cpus;     // expected affinity, empty = not requested
+  int priority {0};          // SCHED_FIFO priority 1..99, 0 = stay SCHED_OTHER
+  bool lock_memory {false};  // mlockall(MCL_CURRENT | MCL_FUTURE)
+};
+
+// "2,3" or "2-3" or "0,2-3", empty string -> empty list
+inline std::vector<int> parse_cpu_list(const std::string & list)
+{
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty()) continue;
+    size_t dash = item.find('-');
+    int first = std::stoi(item.substr(0, dash));
+    int last = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+    for (int c=first; c<=last; c++) cpus.push_back(c);
+  }
+  return cpus;
+}
+
+inline std::string cpu_list_string(const std::vector<int> & cpus)
+{
+  std::string out;
+  for (size_t i=0; i<cpus.size(); i++) out += (i ? "," : "") + std::to_string(cpus[i]);
+  return out.empty() ? "-" : out;
+}
+
+// locked memory of this process in [kB], from /proc/self/status
+inline long locked_memory_kb()
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmLck:", 0) == 0) return std::stol(line.substr(6));
+  }
+  return -1;
+}
+
+// applies the scheduling and memory settings to the calling thread / process and reports requested vs granted,
+// returns true if everything requested was granted
+inline bool apply_rt_settings(const RtSettings & s, std::string & report)
+{
+  std::ostringstream out;
+  bool granted = true;
+
+  // affinity is only checked, it is set by the launch prefix for all threads of the process
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  std::vector<int> current;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int c=0; c<CPU_SETSIZE; c++) if (CPU_ISSET(c, &set)) current.push_back(c);
+  }
+  bool affinity_ok = s.cpus.empty() || current == s.cpus;
+  out << "  affinity:   requested " << cpu_list_string(s.cpus) << ", granted " << cpu_list_string(current)
+      << (affinity_ok ? "  [OK]" : "  [NOT GRANTED] (missing taskset prefix?)") << "\n";
+  granted = granted && affinity_ok;
+
+  if (s.priority > 0) {
+    sched_param param {};
+    param.sched_priority = s.priority;
+    int err = (sched_setscheduler(0, SCHED_FIFO, &param) == 0) ? 0 : errno;
+    sched_param current_param {};
+    sched_getparam(0, &current_param);
+    bool sched_ok = sched_getscheduler(0) == SCHED_FIFO && current_param.sched_priority == s.priority;
+    out << "  scheduling: requested SCHED_FIFO " << s.priority << ", granted "
+        << (sched_getscheduler(0) == SCHED_FIFO ? "SCHED_FIFO " : "SCHED_OTHER ") << current_param.sched_priority
+        << (sched_ok ? "  [OK]" : "  [NOT GRANTED] (" + std::string(std::strerror(err)) + ", check rtprio in /etc/security/limits.conf)") << "\n";
+    granted = granted && sched_ok;
+  } else {
+    out << "  scheduling: not requested (SCHED_OTHER)\n";
+  }
+
+  if (s.lock_memory) {
+    int err = (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) ? 0 : errno;
+    rlimit limit {};
+    getrlimit(RLIMIT_MEMLOCK, &limit);
+    long locked = locked_memory_kb();
+    bool lock_ok = (err == 0) && locked > 0;
+    out << "  memory:     requested locked, granted " << (lock_ok ? "locked (" + std::to_string(locked) + " kB)" : "not locked")
+        << (lock_ok ? "  [OK]" : "  [NOT GRANTED] (" + std::string(std::strerror(err)) + ", memlock limit " +
+            (limit.rlim_cur == RLIM_INFINITY ? std::string("unlimited") : std::to_string(limit.rlim_cur / 1024) + " kB") + ")") << "\n";
+    granted = granted && lock_ok;
+  } else {
+    out << "  memory:     not locked\n";
+  }
+
+  report = out.str();
+  return granted;
+}
+
+
+#endif  // CPP_PUBSUB__RT_SETUP_HPP_
@@ -0,0 +1,244 @@
+#ifndef CPP_PUBSUB__SESSION_CHECKPOINT_HPP_
+#define CPP_PUBSUB__SESSION_CHECKPOINT_HPP_
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/////////////////// session checkpoint ///////////////////
+// Progress of one participant's session, <dir>/part_<part_id>_session.txt, one entry per line:
+//   plan <alpha_id> <traj_id> <alpha_id> <traj_id> ...    conditions of the session, in order
+//   done <alpha_id> <traj_id> <score> <trial log>         a condition whose recording finished cleanly
+//   aborted <alpha_id> <traj_id> <trial log>              an attempt that never finished (joint limits, device loss, crash)
+//   attempt <alpha_id> <traj_id> <trial log>              the condition running right now
+// An attempt line still present at startup means the previous run died; it becomes an aborted entry and the session
+// resumes at the first planned condition that is not done. Every save is a temporary file that is fsync'ed and renamed
+// over the old one (then the directory is fsync'ed), so the file is always either the old or the new state.
+struct SessionCondition
+{
+  int alpha_id {0};
+  int traj_id {0};
+};
+
+struct SessionEntry
+{
+  SessionCondition condition;
+  double score {0.0};
+  std::string log;
+};
+
+class SessionCheckpoint
+{
+public:
+
+  SessionCheckpoint(const std::string & dir, int part_id)
+  : dir_(dir), path_(dir + "part_" + std::to_string(part_id) + "_session.txt") {}
+
+  // returns false if there is no checkpoint for this participant yet; a pending attempt is turned into an aborted entry
+  bool load()
+  {
+    std::ifstream file(path_);
+    if (!file.is_open()) return false;
+
+    plan_.clear();
+    done_.clear();
+    aborted_.clear();
+    has_attempt_ = false;
+    std::string line;
+    while (getline(file, line)) {
+      std::stringstream ss(line);
+      std::string key;
+      if (!(ss >> key)) continue;
+      if (key == "plan") {
+        SessionCondition c;
+        while (ss >> c.alpha_id >> c.traj_id) plan_.push_back(c);
+      } else if (key == "done") {
+        SessionEntry e;
+        if (ss >> e.condition.alpha_id >> e.condition.traj_id >> e.score) { ss >> e.log; done_.push_back(e); }
+      } else if (key == "aborted" || key == "attempt") {
+        SessionEntry e;
+        if (ss >> e.condition.alpha_id >> e.condition.traj_id) { ss >> e.log; aborted_.push_back(e); }
+        if (key == "attempt") recovered_ = true;
+      }
+    }
+    return true;
+  }
+
+  bool save() const
+  {
+    std::string tmp_path = path_ + ".tmp";
+    std::FILE * file = std::fopen(tmp_path.c_str(), "w");
+    if (file == nullptr) return false;
+    std::fprintf(file, "plan");
+    for (const auto & c : plan_) std::fprintf(file, " %d %d", c.alpha_id, c.traj_id);
+    std::fprintf(file, "\n");
+    for (const auto & e : done_) std::fprintf(file, "done %d %d %.6f %s\n", e.condition.alpha_id, e.condition.traj_id, e.score, log_name(e.log));
+    for (const auto & e : aborted_) std::fprintf(file, "aborted %d %d %s\n", e.condition.alpha_id, e.condition.traj_id, log_name(e.log));
+    if (has_attempt_) std::fprintf(file, "attempt %d %d %s\n", attempt_.condition.alpha_id, attempt_.condition.traj_id, log_name(attempt_.log));
+    bool ok = std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(tmp_path.c_str(), path_.c_str()) != 0) return false;
+
+    // make the rename itself durable
+    int dir_fd = ::open(dir_.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+      fsync(dir_fd);
+      ::close(dir_fd);
+    }
+    return true;
+  }
+
+  void set_plan(const std::vector<SessionCondition> & plan) { plan_ = plan; }
+  const std::vector<SessionCondition> & plan() const { return plan_; }
+
+  bool is_done(const SessionCondition & c) const
+  {
+    for (const auto & e : done_) if (e.condition.alpha_id == c.alpha_id && e.condition.traj_id == c.traj_id) return true;
+    return false;
+  }
+
+  // first planned condition that is not done yet, false if the whole plan is done (or there is no plan)
+  bool next(SessionCondition & c) const
+  {
+    for (const auto & p : plan_) {
+      if (!is_done(p)) { c = p; return true; }
+    }
+    return false;
+  }
+
+  int num_done() const
+  {
+    int n = 0;
+    for (const auto & p : plan_) n += is_done(p) ? 1 : 0;
+    return n;
+  }
+
+  // the checkpoint held a pending attempt, i.e. the previous run did not finish
+  bool recovered() const { return recovered_; }
+  const std::vector<SessionEntry> & aborted() const { return aborted_; }
+
+  void begin(const SessionCondition & c, const std::string & log)
+  {
+    attempt_.condition = c;
+    attempt_.score = 0.0;
+    attempt_.log = log;
+    has_attempt_ = true;
+  }
+
+  const SessionCondition & attempt_condition() const { return attempt_.condition; }
+
+  // the condition of the running attempt changed before its recording started (no allocation)
+  void set_attempt_condition(const SessionCondition & c) { attempt_.condition = c; }
+
+  // the running attempt finished its recording
+  void complete(double score)
+  {
+    if (!has_attempt_) return;
+    attempt_.score = score;
+    done_.push_back(attempt_);
+    has_attempt_ = false;
+  }
+
+  // the running attempt is not usable (e.g. the Falcon stream was lost), it is redone on the next start
+  void abort()
+  {
+    if (!has_attempt_) return;
+    aborted_.push_back(attempt_);
+    has_attempt_ = false;
+  }
+
+  const std::string & path() const { return path_; }
+
+private:
+
+  static const char * log_name(const std::string & log) { return log.empty() ? "-" : log.c_str(); }
+
+  std::string dir_;
+  std::string path_;
+  std::vector<SessionCondition> plan_;
+  std::vector<SessionEntry> done_;
+  std::vector<SessionEntry> aborted_;
+  SessionEntry attempt_;
+  bool has_attempt_ {false};
+  bool recovered_ {false};
+};
+
+
+/////////////////// checkpoint saves off the control thread ///////////////////
+// The worker is created once at startup; the control thread only flags a save (no allocation, no syscall beyond the
+// notify). The checkpoint must not change until the save is done; the controller only touches it again after the
+// recording ends, which is when it requests the save. A save still pending at stop() is written before the worker exits.
+class SessionSaver
+{
+public:
+
+  ~SessionSaver() { stop(); }
+
+  void start(const SessionCheckpoint * session)
+  {
+    session_ = session;
+    running_ = true;
+    worker_ = std::thread([this]() { save_loop(); });
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    cv_.notify_one();
+    if (worker_.joinable()) worker_.join();
+  }
+
+  // control thread: the worker only holds the lock to check / clear the flag, never during a save
+  void request()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_ = true;
+    }
+    cv_.notify_one();
+  }
+
+private:
+
+  void save_loop()
+  {
+    // never inherit the control thread's real-time class
+    sched_param param {};
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this]() { return pending_ || !running_; });
+      if (!pending_) return;
+      pending_ = false;
+      lock.unlock();
+      if (session_->save()) std::cout << "Session checkpoint saved to " << session_->path() << std::endl;
+      else std::cerr << "Unable to write the session checkpoint " << session_->path() << std::endl;
+      lock.lock();
+    }
+  }
+
+  const SessionCheckpoint * session_ {nullptr};
+  bool pending_ {false};
+  bool running_ {false};
+  std::thread worker_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+
+#endif  // CPP_PUBSUB__SESSION_CHECKPOINT_HPP_
@@ -0,0 +1,228 @@
+#ifndef CPP_PUBSUB__SHARED_MPC_HPP_
+#define CPP_PUBSUB__SHARED_MPC_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+
+/////////////////// model-predictive shared control ///////////////////
+// Per axis, the TCP offsets x_1 ... x_N over the next N control ticks minimize
+//
+//   sum_k  a (x_k - h)^2  +  (1 - a) (x_k - r_k)^2  +  w_d (x_k - x_{k-1})^2
+//
+// with h = operator (Falcon) target held over the horizon, r_k = robot target (reference + noise) at tick k,
+// a = the axis' alpha and x_0 = the last commanded offset, subject to
+//
+//   lo <= x_k <= hi                    (task-space box, tightened by the joint position limits, see joint_limit_bounds)
+//   |x_k - x_{k-1}| <= d_max           (TCP speed limit per tick, tightened by the joint velocity limits)
+//
+// Without smoothing and inactive constraints, x_1 is exactly the convex blend a h + (1 - a) r_1.
+// The axes are independent, the Hessian is tridiagonal, and the QP is solved with a fixed-size, warm-started
+// ADMM (OSQP-style splitting) whose linear system is factored in O(N) per solve.
+
+struct MpcSettings
+{
+  double smoothing {0.0};     // w_d
+  double max_step {0.0005};   // d_max [m per tick]
+  double lo[3] {-0.15, -0.25, -0.20};
+  double hi[3] {0.15, 0.25, 0.20};
+  double joint_margin {0.05};         // kept from every joint position limit [rad]
+  double joint_speed_fraction {0.5};  // share of the joint velocity limits the TCP motion may use
+
+  double rho {10.0};
+  double sigma {1e-6};
+  double relaxation {1.6};
+  double eps {1e-7};          // absolute residual tolerance [m]
+  int max_iter {200};        // bounds the solve time, the applied move is projected onto the constraints anyway
+};
+
+template<int N>
+class AxisQP
+{
+public:
+
+  // returns the number of ADMM iterations, result in x()
+  int solve(double x0, double h, const double * r, double a, double lo, double hi, double d_max, const MpcSettings & s)
+  {
+    const double rho = s.rho;
+    const double sigma = s.sigma;
+    const double alpha = s.relaxation;
+
+    // cost 1/2 x'Px + q'x with P = 2 (a + (1 - a)) I + 2 w_d D'D, D = first differences with x_0 moved into q / bounds
+    const double wp = 2.0;
+    const double wd = 2.0 * s.smoothing;
+    for (int k=0; k<N; k++) q_[k] = -2.0 * (a * h + (1.0 - a) * r[k]);
+    q_[0] -= wd * x0;
+
+    // constraints A x = [x; D x] in [l, u]
+    for (int k=0; k<N; k++) {
+      l_box_[k] = lo; u_box_[k] = hi;
+      l_dif_[k] = -d_max; u_dif_[k] = d_max;
+    }
+    l_dif_[0] += x0; u_dif_[0] += x0;
+
+    // factor M = P + sigma I + rho A'A = (wp + sigma + rho) I + (wd + rho) D'D (tridiagonal, Thomas algorithm)
+    const double diag0 = wp + sigma + rho;
+    const double b = wd + rho;
+    for (int k=0; k<N; k++) {
+      double dd = (k < N-1) ? 2.0 : 1.0;
+      double m = diag0 + b * dd + ((k > 0) ? b * cp_[k-1] : 0.0);
+      inv_[k] = 1.0 / m;
+      cp_[k] = -b * inv_[k];
+    }
+
+    int it = 0;
+    for (it=1; it<=s.max_iter; it++) {
+      // rhs = sigma x - q + A'(rho z - y)
+      for (int k=0; k<N; k++) {
+        tmp_[k] = rho * z_box_[k] - y_box_[k];
+        tmp2_[k] = rho * z_dif_[k] - y_dif_[k];
+      }
+      for (int k=0; k<N; k++) {
+        double dt_v = tmp2_[k] - ((k < N-1) ? tmp2_[k+1] : 0.0);   // D' v
+        rhs_[k] = sigma * x_[k] - q_[k] + tmp_[k] + dt_v;
+      }
+
+      // forward / backward substitution
+      rhs_[0] *= inv_[0];
+      for (int k=1; k<N; k++) rhs_[k] = (rhs_[k] + b * rhs_[k-1]) * inv_[k];
+      for (int k=N-2; k>=0; k--) rhs_[k] -= cp_[k] * rhs_[k+1];
+
+      // relaxed updates of x, z and y
+      double prim = 0.0;
+      for (int k=0; k<N; k++) {
+        double xt = rhs_[k];
+        double dxt = xt - ((k > 0) ? rhs_[k-1] : 0.0);
+
+        double zb = alpha * xt + (1.0 - alpha) * z_box_[k];
+        double zd = alpha * dxt + (1.0 - alpha) * z_dif_[k];
+
+        x_[k] = alpha * xt + (1.0 - alpha) * x_[k];
+
+        double nb = std::clamp(zb + y_box_[k] / rho, l_box_[k], u_box_[k]);
+        double nd = std::clamp(zd + y_dif_[k] / rho, l_dif_[k], u_dif_[k]);
+        y_box_[k] += rho * (zb - nb);
+        y_dif_[k] += rho * (zd - nd);
+        z_box_[k] = nb;
+        z_dif_[k] = nd;
+
+        prim = std::max(prim, std::abs(xt - nb));
+        prim = std::max(prim, std::abs(dxt - nd));
+      }
+
+      if (it % 5 == 0 && prim < s.eps && dual_residual(wp, wd) < s.eps * rho) break;
+    }
+    converged_ = (it <= s.max_iter);
+    return std::min(it, s.max_iter);
+  }
+
+  // first move, projected onto the box and speed limit so an early-terminated solve still gives a safe command
+  double first_move(double x0, double lo, double hi, double d_max) const
+  {
+    double x1 = std::clamp(x_[0], x0 - d_max, x0 + d_max);
+    return std::clamp(x1, lo, hi);
+  }
+
+  // shift the previous solution by one tick to warm-start the next solve
+  void shift()
+  {
+    for (int k=0; k<N-1; k++) {
+      x_[k] = x_[k+1];
+      z_box_[k] = z_box_[k+1]; y_box_[k] = y_box_[k+1];
+      z_dif_[k] = z_dif_[k+1]; y_dif_[k] = y_dif_[k+1];
+    }
+  }
+
+  void reset(double x0)
+  {
+    x_.fill(x0); z_box_.fill(x0); y_box_.fill(0.0);
+    z_dif_.fill(0.0); y_dif_.fill(0.0);
+    z_dif_[0] = x0;
+  }
+
+  const std::array<double, N> & x() const { return x_; }
+  bool converged() const { return converged_; }
+
+private:
+
+  // ||P x + q + A' y||_inf
+  double dual_residual(double wp, double wd) const
+  {
+    double res = 0.0;
+    for (int k=0; k<N; k++) {
+      double dx_k = x_[k] - ((k > 0) ? x_[k-1] : 0.0);
+      double dx_n = (k < N-1) ? (x_[k+1] - x_[k]) : 0.0;
+      double px = wp * x_[k] + wd * (dx_k - dx_n);
+      double aty = y_box_[k] + y_dif_[k] - ((k < N-1) ? y_dif_[k+1] : 0.0);
+      res = std::max(res, std::abs(px + q_[k] + aty));
+    }
+    return res;
+  }
+
+  std::array<double, N> x_ {}, q_ {}, rhs_ {}, tmp_ {}, tmp2_ {};
+  std::array<double, N> z_box_ {}, y_box_ {}, l_box_ {}, u_box_ {};
+  std::array<double, N> z_dif_ {}, y_dif_ {}, l_dif_ {}, u_dif_ {};
+  std::array<double, N> inv_ {}, cp_ {};
+  bool converged_ {false};
+};
+
+
+/////////////////// joint limits as per-axis bounds ///////////////////
+// Column i of dq/dx (c[i], the position part of the Jacobian pseudo-inverse with the orientation held) linearises the
+// joints around the current joint values q: dq = sum_i c[i] dx_i. A joint constraint couples the three axes, which
+// the separate per-axis QPs cannot express, so every joint's remaining range (minus joint_margin) and velocity budget
+// is split equally over the axes. That is an inner approximation of the linearised joint-limit polytope: any x with
+// every axis inside its bounds keeps every joint inside its limits (to first order). Per axis, the task-space box
+// [lo, hi] is tightened around the last commanded offset x0 and the step limit d_max to step.
+template<int J>
+void joint_limit_bounds(const double (&c)[3][J], const double * q, const double * q_lo, const double * q_hi, const double * qd_max,
+                        double dt, const double * x0, const MpcSettings & s, double * lo, double * hi, double * step)
+{
+  for (int i=0; i<3; i++) {
+    double dx_min = -1e9, dx_max = 1e9;
+    step[i] = s.max_step;
+    for (int j=0; j<J; j++) {
+      double cj = c[i][j];
+      if (std::abs(cj) < 1e-9) continue;
+      // this axis' share of the joint's room towards either limit, 0 once the joint is inside the margin
+      double down = std::min(q_lo[j] + s.joint_margin - q[j], 0.0) / 3;
+      double up = std::max(q_hi[j] - s.joint_margin - q[j], 0.0) / 3;
+      dx_min = std::max(dx_min, ((cj > 0) ? down : up) / cj);
+      dx_max = std::min(dx_max, ((cj > 0) ? up : down) / cj);
+      step[i] = std::min(step[i], s.joint_speed_fraction * qd_max[j] * dt / 3 / std::abs(cj));
+    }
+    lo[i] = std::max(s.lo[i], std::min(x0[i] + dx_min, s.hi[i]));
+    hi[i] = std::min(s.hi[i], std::max(x0[i] + dx_max, s.lo[i]));
+    if (lo[i] > hi[i]) lo[i] = hi[i] = std::clamp(x0[i], s.lo[i], s.hi[i]);
+  }
+}
+
+
+/////////////////// solve-time statistics ///////////////////
+struct SolveStats
+{
+  void add(double micros, int iters, bool converged)
+  {
+    n++;
+    sum_us += micros;
+    max_us = std::max(max_us, micros);
+    sum_iter += iters;
+    max_iter = std::max(max_iter, iters);
+    if (!converged) not_converged++;
+  }
+  void clear() { *this = SolveStats(); }
+
+  double mean_us() const { return (n > 0) ? sum_us / n : 0.0; }
+  double mean_iter() const { return (n > 0) ? (double) sum_iter / n : 0.0; }
+
+  long n {0};
+  double sum_us {0.0};
+  double max_us {0.0};
+  long sum_iter {0};
+  int max_iter {0};
+  long not_converged {0};
+};
+
+
+#endif  // CPP_PUBSUB__SHARED_MPC_HPP_
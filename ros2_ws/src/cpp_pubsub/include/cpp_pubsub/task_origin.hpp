@@ -0,0 +1,50 @@
+#ifndef CPP_PUBSUB__TASK_ORIGIN_HPP_
+#define CPP_PUBSUB__TASK_ORIGIN_HPP_
+
+#include <vector>
+
+
+/////////////////// task-space origin per trajectory ///////////////////
+// config/origin.yaml has the shared "origin" and "traj_origins" with one x, y, z per traj_id (see origin_optimizer).
+// traj_origins is only used when it is complete, i.e. every trajectory has its origin; otherwise every trajectory uses
+// the shared one. real_controller and marker_publisher both select through this, so they never disagree.
+class TaskOrigins
+{
+public:
+
+  static constexpr int num_trajs = 6;
+
+  // returns false if traj_origins was given but is incomplete, it is ignored then
+  bool configure(const std::vector<double> & shared, const std::vector<double> & traj_origins)
+  {
+    for (int i=0; i<3; i++) shared_[i] = shared.at(i);
+    per_traj_ = traj_origins.size() == 3 * num_trajs;
+    for (int k=0; k<3*num_trajs; k++) traj_[k] = per_traj_ ? traj_origins.at(k) : shared_[k % 3];
+    return per_traj_ || traj_origins.empty();
+  }
+
+  void get(int traj_id, double * o) const
+  {
+    bool valid = per_traj_ && traj_id >= 0 && traj_id < num_trajs;
+    for (int i=0; i<3; i++) o[i] = valid ? traj_[3*traj_id + i] : shared_[i];
+  }
+
+  bool same(int traj_a, int traj_b) const
+  {
+    double a[3], b[3];
+    get(traj_a, a);
+    get(traj_b, b);
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+  }
+
+  bool per_traj() const { return per_traj_; }
+
+private:
+
+  double shared_[3] {0.0, 0.0, 0.0};
+  double traj_[3*num_trajs] {};
+  bool per_traj_ {false};
+};
+
+
+#endif  // CPP_PUBSUB__TASK_ORIGIN_HPP_
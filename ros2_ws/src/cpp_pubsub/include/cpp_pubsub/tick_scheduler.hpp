@@ -0,0 +1,79 @@
+#ifndef CPP_PUBSUB__TICK_SCHEDULER_HPP_
+#define CPP_PUBSUB__TICK_SCHEDULER_HPP_
+
+#include <algorithm>
+#include <chrono>
+
+
+/////////////////// drift-free tick scheduling ///////////////////
+// Tick k is due at epoch + k * period (absolute monotonic time), so late wake-ups never accumulate into drift.
+// If a wake-up finds more than one tick due, the extra ones are overruns and are handled by the policy:
+//   catch_up -> run all due ticks back-to-back (tick count stays locked to time)
+//   skip     -> run one tick and drop the rest (the schedule is shifted by the dropped ticks)
+//   compress -> run at most max_burst ticks per wake-up, the remainder is caught up on the following wake-ups
+enum class TickPolicy { catch_up = 0, skip = 1, compress = 2 };
+
+class TickScheduler
+{
+public:
+
+  using Clock = std::chrono::steady_clock;
+
+  void start(Clock::time_point epoch, Clock::duration period, TickPolicy policy, int max_burst)
+  {
+    epoch_ = epoch;
+    period_ = period;
+    policy_ = policy;
+    max_burst_ = std::max(max_burst, 1);
+    tolerance_ = period / 10;   // a wake-up up to 10% early still counts for the tick (timer jitter)
+    next_tick_ = 0;
+    overruns_ = 0;
+    skipped_ = 0;
+  }
+
+  // number of ticks to run now
+  int due(Clock::time_point now)
+  {
+    long elapsed = (now - epoch_ + tolerance_) / period_ + 1;   // ticks whose deadline has passed
+    long pending = elapsed - next_tick_;
+    if (pending <= 0) return 0;
+    if (pending > 1) overruns_ += pending - 1;
+
+    long run = pending;
+    switch (policy_) {
+      case TickPolicy::catch_up: break;
+      case TickPolicy::skip:
+        run = 1;
+        skipped_ += pending - 1;
+        epoch_ += (pending - 1) * period_;
+        break;
+      case TickPolicy::compress:
+        run = std::min<long>(pending, max_burst_);
+        break;
+    }
+    next_tick_ += run;
+    return (int) run;
+  }
+
+  Clock::time_point next_deadline() const { return epoch_ + next_tick_ * period_; }
+  Clock::time_point epoch() const { return epoch_; }
+
+  long ticks() const { return next_tick_; }
+  long overruns() const { return overruns_; }
+  long skipped() const { return skipped_; }
+
+private:
+
+  Clock::time_point epoch_ {};
+  Clock::duration period_ {std::chrono::milliseconds(2)};
+  Clock::duration tolerance_ {};
+  TickPolicy policy_ {TickPolicy::catch_up};
+  int max_burst_ {1};
+
+  long next_tick_ {0};
+  long overruns_ {0};
+  long skipped_ {0};
+};
+
+
+#endif  // CPP_PUBSUB__TICK_SCHEDULER_HPP_
@@ -0,0 +1,72 @@
+#ifndef CPP_PUBSUB__TRACKING_SCORE_HPP_
+#define CPP_PUBSUB__TRACKING_SCORE_HPP_
+
+#include <algorithm>
+#include <cmath>
+
+
+/////////////////// online tracking score ///////////////////
+// Running statistics (O(1) per sample, no history) of the 3D distance between the TCP and the reference:
+//   - RMS and max over the whole trial so far
+//   - recent RMS, an exponential moving average of the squared error with time constant recent_time
+// The score maps an RMS error to [0, 100]: 100 / (1 + (rms / half_score_error)^2), i.e. half_score_error
+// is worth 50 points, a perfect trial 100.
+struct ScoreSettings
+{
+  double half_score_error {0.02};   // [m RMS]
+  double recent_time {1.0};         // [s]
+};
+
+class TrackingScore
+{
+public:
+
+  void configure(const ScoreSettings & s, double sample_rate)
+  {
+    settings_ = s;
+    recent_weight_ = 1.0 - std::exp(-1.0 / (std::max(s.recent_time, 1e-3) * sample_rate));
+  }
+
+  void reset()
+  {
+    n_ = 0;
+    sum_sq_ = 0.0;
+    recent_sq_ = 0.0;
+    max_ = 0.0;
+  }
+
+  void add_sample(const double * tcp, const double * ref)
+  {
+    double sq = 0.0;
+    for (int i=0; i<3; i++) sq += (tcp[i] - ref[i]) * (tcp[i] - ref[i]);
+    sum_sq_ += sq;
+    recent_sq_ = (n_ == 0) ? sq : recent_sq_ + recent_weight_ * (sq - recent_sq_);
+    max_ = std::max(max_, std::sqrt(sq));
+    n_++;
+  }
+
+  long num_samples() const { return n_; }
+  double rms() const { return (n_ > 0) ? std::sqrt(sum_sq_ / n_) : 0.0; }
+  double recent_rms() const { return std::sqrt(recent_sq_); }
+  double max_error() const { return max_; }
+  double score() const { return score_of(rms()); }
+  double recent_score() const { return score_of(recent_rms()); }
+
+  double score_of(double rms_error) const
+  {
+    double r = rms_error / std::max(settings_.half_score_error, 1e-6);
+    return 100.0 / (1.0 + r * r);
+  }
+
+private:
+
+  ScoreSettings settings_;
+  double recent_weight_ {1.0};
+  long n_ {0};
+  double sum_sq_ {0.0};
+  double recent_sq_ {0.0};
+  double max_ {0.0};
+};
+
+
+#endif  // CPP_PUBSUB__TRACKING_SCORE_HPP_
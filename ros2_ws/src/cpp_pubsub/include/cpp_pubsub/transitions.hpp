@@ -0,0 +1,61 @@
+#ifndef CPP_PUBSUB__TRANSITIONS_HPP_
+#define CPP_PUBSUB__TRANSITIONS_HPP_
+
+#include <vector>
+
+
+/////////////////// blend profile types ///////////////////
+// all profiles map tau = [0, 1] onto s = [0, 1] with s(0) = 0 and s(1) = 1
+//   linear  -> s = tau                                   (velocity step at both ends)
+//   cubic   -> s = 3 tau^2 - 2 tau^3                     (zero velocity at both ends)
+//   quintic -> s = 10 tau^3 - 15 tau^4 + 6 tau^5         (minimum-jerk: zero velocity AND acceleration at both ends)
+enum class BlendType { linear = 0, cubic = 1, quintic = 2 };
+
+inline double blend_value(BlendType type, double tau)
+{
+  if (tau <= 0.0) return 0.0;
+  if (tau >= 1.0) return 1.0;
+
+  switch (type) {
+    case BlendType::linear:  return tau;
+    case BlendType::cubic:   return tau * tau * (3.0 - 2.0 * tau);
+    case BlendType::quintic: return tau * tau * tau * (10.0 + tau * (-15.0 + 6.0 * tau));
+  }
+  return tau;
+}
+
+
+/////////////////// precomputed blend table (one entry per control tick) ///////////////////
+class BlendProfile
+{
+public:
+
+  BlendProfile() {}
+
+  BlendProfile(int num_ticks, BlendType type) { build(num_ticks, type); }
+
+  // fill in s(k / num_ticks) for k = {0, ..., num_ticks}, so the phase reaches 1.0 exactly at its last tick
+  void build(int num_ticks, BlendType type)
+  {
+    if (num_ticks < 1) num_ticks = 1;
+    table_.resize(num_ticks + 1);
+    for (int k=0; k<=num_ticks; k++) table_.at(k) = blend_value(type, (double) k / num_ticks);
+  }
+
+  // ticks before the phase give 0.0, ticks after the phase give 1.0
+  double at(int tick) const
+  {
+    if (tick <= 0) return 0.0;
+    if (tick >= (int) table_.size() - 1) return 1.0;
+    return table_[tick];
+  }
+
+  int num_ticks() const { return (int) table_.size() - 1; }
+
+private:
+
+  std::vector<double> table_ {0.0, 1.0};
+};
+
+
+#endif  // CPP_PUBSUB__TRANSITIONS_HPP_
@@ -0,0 +1,259 @@
+#ifndef CPP_PUBSUB__TRIAL_LOG_HPP_
+#define CPP_PUBSUB__TRIAL_LOG_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+/////////////////// binary trial log ///////////////////
+// One fixed-size header followed by one fixed-size record per controller tick, written in native byte order.
+// The records are plain structs so a log can be memory-mapped and indexed directly (see TrialLogReader);
+// a log cut short by a crash is still readable up to its last complete record.
+constexpr char trial_log_magic[8] = {'H', 'R', 'I', 'T', 'L', 'O', 'G', '1'};
+constexpr uint32_t trial_log_version = 1;
+
+enum class TrialPhase : int32_t { smoothing = 0, recording = 1, shifting = 2, homing = 3 };
+
+struct TrialLogHeader
+{
+  char magic[8];
+  uint32_t version {trial_log_version};
+  uint32_t header_size {0};
+  uint32_t record_size {0};
+  uint32_t control_freq {0};
+  int32_t part_id {0};
+  int32_t alpha_id {0};
+  int32_t traj_id {0};
+  int32_t use_depth {0};
+  int32_t arc_length {0};
+  int32_t free_drive {0};
+  double mapping_ratio {0.0};
+  double origin[3] {0.0, 0.0, 0.0};
+  double start_time {0.0};   // wall clock at the first record [s since epoch]
+};
+
+struct TrialLogRecord
+{
+  int64_t tick {0};          // controller count at the start of the tick (the one that indexed ref)
+  int32_t phase {0};         // TrialPhase
+  int32_t flags {0};         // bit 0 = record flag, bit 1 = clutched
+  double time {0.0};         // monotonic time since the node started [s]
+  double time_from_start {0.0};   // reference time, (tick - smoothing ticks) / control_freq [s], negative before
+  double ref[3];             // all positions in the robot base frame [m]
+  double human[3];
+  double robot[3];
+  double tcp[3];             // commanded
+  double alpha[3];
+  double joints_measured[7];    // [rad]
+  double joints_commanded[7];   // [rad]
+};
+
+static_assert(std::is_trivially_copyable<TrialLogRecord>::value, "trial log records are written and mapped as raw bytes");
+static_assert(std::is_trivially_copyable<TrialLogHeader>::value, "the trial log header is written and mapped as raw bytes");
+
+constexpr int32_t trial_log_record_flag = 1;
+constexpr int32_t trial_log_clutched_flag = 2;
+
+
+/////////////////// writer ///////////////////
+// The control thread fills preallocated records (no allocation, no system call), a writer thread appends
+// the committed ones to the file every flush_period. Capacity is the whole trial, records past it are dropped.
+// sync() (at phase boundaries) additionally makes the writer thread fsync, so a crash or power loss loses at most
+// the current phase; close() always syncs.
+class TrialLogWriter
+{
+public:
+
+  ~TrialLogWriter() { close(); }
+
+  bool open(const std::string & path, const TrialLogHeader & header, long capacity,
+            std::chrono::milliseconds flush_period = std::chrono::milliseconds(100))
+  {
+    close();
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) return false;
+    header_ = header;
+    std::memcpy(header_.magic, trial_log_magic, sizeof(trial_log_magic));
+    header_.header_size = sizeof(TrialLogHeader);
+    header_.record_size = sizeof(TrialLogRecord);
+    header_.start_time = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::fwrite(&header_, sizeof(header_), 1, file_);
+
+    records_.assign(std::max(capacity, 1L), TrialLogRecord());
+    committed_ = 0;
+    written_ = 0;
+    dropped_ = 0;
+    sync_requested_ = false;
+    path_ = path;
+    running_ = true;
+    flush_period_ = flush_period;
+    flusher_ = std::thread([this]() { flush_loop(); });
+    return true;
+  }
+
+  bool is_open() const { return file_ != nullptr; }
+
+  // control thread: the record to fill for this tick, nullptr if the log is closed or full
+  TrialLogRecord * next()
+  {
+    if (file_ == nullptr) return nullptr;
+    long i = committed_.load(std::memory_order_relaxed);
+    if (i >= (long) records_.size()) { dropped_++; return nullptr; }
+    return &records_[i];
+  }
+
+  // control thread: hands the record returned by next() over to the writer thread
+  void commit() { committed_.fetch_add(1, std::memory_order_release); }
+
+  // control thread: asks the writer thread to write and fsync everything committed so far, does not block
+  void sync()
+  {
+    if (file_ == nullptr) return;
+    sync_requested_.store(true, std::memory_order_release);
+    cv_.notify_one();
+  }
+
+  // writes everything committed so far and closes the file
+  void close()
+  {
+    if (file_ == nullptr) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    cv_.notify_one();
+    if (flusher_.joinable()) flusher_.join();
+    write_committed();
+    fsync(fileno(file_));
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+  long num_committed() const { return committed_.load(std::memory_order_acquire); }
+  long num_dropped() const { return dropped_; }
+  const std::string & path() const { return path_; }
+
+private:
+
+  void flush_loop()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+      cv_.wait_for(lock, flush_period_, [this]() { return !running_ || sync_requested_.load(std::memory_order_acquire); });
+      lock.unlock();
+      write_committed();
+      if (sync_requested_.exchange(false, std::memory_order_acq_rel)) fsync(fileno(file_));
+      lock.lock();
+    }
+  }
+
+  // writer thread (or close() after it was joined)
+  void write_committed()
+  {
+    long end = committed_.load(std::memory_order_acquire);
+    if (end > written_) {
+      std::fwrite(&records_[written_], sizeof(TrialLogRecord), end - written_, file_);
+      std::fflush(file_);
+      written_ = end;
+    }
+  }
+
+  std::FILE * file_ {nullptr};
+  std::string path_;
+  TrialLogHeader header_;
+  std::vector<TrialLogRecord> records_;
+  std::atomic<long> committed_ {0};
+  long written_ {0};
+  long dropped_ {0};
+  std::atomic<bool> sync_requested_ {false};
+  std::thread flusher_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_ {false};
+  std::chrono::milliseconds flush_period_ {100};
+};
+
+
+/////////////////// memory-mapped reader ///////////////////
+// Seeking is a binary search over the mapped records, nothing is read until a record is touched.
+class TrialLogReader
+{
+public:
+
+  ~TrialLogReader() { close(); }
+
+  bool open(const std::string & path)
+  {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(TrialLogHeader)) { ::close(fd); return false; }
+    void * data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+    data_ = static_cast<const char *>(data);
+    size_ = st.st_size;
+
+    header_ = reinterpret_cast<const TrialLogHeader *>(data_);
+    if (std::memcmp(header_->magic, trial_log_magic, sizeof(trial_log_magic)) != 0 || header_->version != trial_log_version ||
+        header_->record_size != sizeof(TrialLogRecord) || header_->header_size != sizeof(TrialLogHeader)) {
+      close();
+      return false;
+    }
+    records_ = reinterpret_cast<const TrialLogRecord *>(data_ + sizeof(TrialLogHeader));
+    num_records_ = (size_ - sizeof(TrialLogHeader)) / sizeof(TrialLogRecord);   // an incomplete last record is ignored
+    madvise(const_cast<char *>(data_), size_, MADV_RANDOM);
+    return true;
+  }
+
+  void close()
+  {
+    if (data_ != nullptr) munmap(const_cast<char *>(data_), size_);
+    data_ = nullptr;
+    header_ = nullptr;
+    records_ = nullptr;
+    num_records_ = 0;
+  }
+
+  const TrialLogHeader & header() const { return *header_; }
+  long size() const { return num_records_; }
+  const TrialLogRecord & at(long i) const { return records_[std::clamp(i, 0L, num_records_ - 1)]; }
+
+  double start_time() const { return num_records_ > 0 ? records_[0].time : 0.0; }
+  double end_time() const { return num_records_ > 0 ? records_[num_records_ - 1].time : 0.0; }
+
+  // index of the last record at or before the given monotonic time
+  long index_at(double time) const
+  {
+    const TrialLogRecord * it = std::upper_bound(records_, records_ + num_records_, time,
+                                                 [](double t, const TrialLogRecord & r) { return t < r.time; });
+    return std::max(0L, (long) (it - records_) - 1);
+  }
+
+private:
+
+  const char * data_ {nullptr};
+  size_t size_ {0};
+  const TrialLogHeader * header_ {nullptr};
+  const TrialLogRecord * records_ {nullptr};
+  long num_records_ {0};
+};
+
+
+#endif  // CPP_PUBSUB__TRIAL_LOG_HPP_
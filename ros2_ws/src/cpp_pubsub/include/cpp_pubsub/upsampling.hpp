@@ -0,0 +1,155 @@
+#ifndef CPP_PUBSUB__UPSAMPLING_HPP_
+#define CPP_PUBSUB__UPSAMPLING_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+/////////////////// signal upsampling ///////////////////
+// Upsamples n samples by an integer factor into (n - 1) * factor + 1 samples; every kernel passes exactly
+// through the input samples. The fixed kernels are FIR filters with precomputed weights stored tap-major,
+// W[t][j] for output phase j, so the inner loop runs over contiguous phases and is vectorized by the compiler:
+//   linear      -> 2 taps, piecewise linear (slope jumps at every input sample)
+//   cosine      -> 2 taps, zero slope at every input sample
+//   catmull_rom -> 4 taps, C1 continuous, can overshoot slightly
+//   hermite     -> monotone cubic Hermite (Fritsch-Carlson tangents), C1 continuous, never overshoots the data
+//   lanczos     -> 6-tap windowed sinc (Lanczos-3), closest to band-limited, rings near steps
+// Edges are extended by repeating the first / last sample.
+enum class KernelType { linear = 0, cosine = 1, catmull_rom = 2, hermite = 3, lanczos = 4 };
+
+inline int upsampled_size(int n, int factor) { return n < 1 ? 0 : (n - 1) * factor + 1; }
+
+class Upsampler
+{
+public:
+
+  void configure(KernelType type, int factor)
+  {
+    type_ = type;
+    factor_ = std::max(factor, 1);
+    switch (type_) {
+      case KernelType::linear:      taps_ = 2; break;
+      case KernelType::cosine:      taps_ = 2; break;
+      case KernelType::catmull_rom: taps_ = 4; break;
+      case KernelType::hermite:     taps_ = 4; break;   // basis tables instead of weights, see run_hermite()
+      case KernelType::lanczos:     taps_ = 6; break;
+    }
+    weights_.assign(taps_ * factor_, 0.0);
+    for (int j=0; j<factor_; j++) {
+      double mu = (double) j / factor_;
+      for (int t=0; t<taps_; t++) weights_[t * factor_ + j] = weight(t - (taps_ / 2 - 1) - mu, mu, t);
+    }
+  }
+
+  // preallocate for inputs of up to max_n samples, no allocation in run() after this
+  void reserve(int max_n)
+  {
+    padded_.resize(max_n + taps_);
+    tangents_.resize(max_n);
+  }
+
+  // out must hold upsampled_size(n, factor) values
+  void run(const double * in, int n, double * out)
+  {
+    if (n < 1) return;
+    if ((int) padded_.size() < n + taps_) reserve(n);
+    const int pad = taps_ / 2 - 1;
+    for (int k=0; k<n+taps_; k++) padded_[k] = in[std::clamp(k - pad, 0, n - 1)];
+
+    if (type_ == KernelType::hermite) run_hermite(in, n, out);
+    else {
+      for (int i=0; i<n-1; i++) {
+        double * seg = out + i * factor_;
+        const double * x = padded_.data() + i;   // x[pad] = in[i]
+        for (int j=0; j<factor_; j++) seg[j] = 0.0;
+        for (int t=0; t<taps_; t++) {
+          const double xt = x[t];
+          const double * w = weights_.data() + t * factor_;
+          for (int j=0; j<factor_; j++) seg[j] += w[j] * xt;
+        }
+      }
+    }
+    out[(n - 1) * factor_] = in[n - 1];
+  }
+
+  std::vector<double> run(const std::vector<double> & in)
+  {
+    std::vector<double> out(upsampled_size(in.size(), factor_));
+    run(in.data(), in.size(), out.data());
+    return out;
+  }
+
+  int factor() const { return factor_; }
+
+private:
+
+  // weight of the sample at integer offset d from the output position (fixed kernels)
+  double weight(double d, double mu, int t) const
+  {
+    double x = std::abs(d);
+    switch (type_) {
+      case KernelType::linear:
+        return std::max(0.0, 1.0 - x);
+      case KernelType::cosine: {
+        double m = 0.5 - 0.5 * std::cos(M_PI * mu);
+        return t == 0 ? 1.0 - m : m;
+      }
+      case KernelType::catmull_rom:
+        if (x < 1.0) return 1.5 * x * x * x - 2.5 * x * x + 1.0;
+        if (x < 2.0) return -0.5 * x * x * x + 2.5 * x * x - 4.0 * x + 2.0;
+        return 0.0;
+      case KernelType::lanczos: {
+        const double a = 3.0;
+        if (x < 1e-12) return 1.0;
+        if (x >= a) return 0.0;
+        return a * std::sin(M_PI * x) * std::sin(M_PI * x / a) / (M_PI * M_PI * x * x);
+      }
+      case KernelType::hermite:
+        break;
+    }
+    return 0.0;
+  }
+
+  // monotone cubic Hermite: data-dependent tangents, then the Hermite basis (tap-major like the FIR weights)
+  void run_hermite(const double * in, int n, double * out)
+  {
+    if (n == 1) return;
+    double * m = tangents_.data();
+    for (int k=0; k<n; k++) {
+      double d_prev = (k > 0) ? in[k] - in[k-1] : in[k+1] - in[k];
+      double d_next = (k < n-1) ? in[k+1] - in[k] : d_prev;
+      m[k] = (d_prev * d_next <= 0.0) ? 0.0 : 2.0 * d_prev * d_next / (d_prev + d_next);   // harmonic mean, Fritsch-Carlson
+    }
+    if ((int) basis_.size() != 4 * factor_) {
+      basis_.resize(4 * factor_);
+      for (int j=0; j<factor_; j++) {
+        double s = (double) j / factor_, s2 = s * s, s3 = s2 * s;
+        basis_[0 * factor_ + j] = 2 * s3 - 3 * s2 + 1;   // p0
+        basis_[1 * factor_ + j] = s3 - 2 * s2 + s;       // m0
+        basis_[2 * factor_ + j] = -2 * s3 + 3 * s2;      // p1
+        basis_[3 * factor_ + j] = s3 - s2;               // m1
+      }
+    }
+    const double * h00 = basis_.data();
+    const double * h10 = h00 + factor_;
+    const double * h01 = h10 + factor_;
+    const double * h11 = h01 + factor_;
+    for (int i=0; i<n-1; i++) {
+      double * seg = out + i * factor_;
+      const double p0 = in[i], p1 = in[i+1], m0 = m[i], m1 = m[i+1];
+      for (int j=0; j<factor_; j++) seg[j] = h00[j] * p0 + h10[j] * m0 + h01[j] * p1 + h11[j] * m1;
+    }
+  }
+
+  KernelType type_ {KernelType::linear};
+  int factor_ {1};
+  int taps_ {2};
+  std::vector<double> weights_;
+  std::vector<double> basis_;
+  std::vector<double> padded_;
+  std::vector<double> tangents_;
+};
+
+
+#endif  // CPP_PUBSUB__UPSAMPLING_HPP_
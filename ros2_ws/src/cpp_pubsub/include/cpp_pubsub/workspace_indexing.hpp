@@ -0,0 +1,61 @@
+#ifndef CPP_PUBSUB__WORKSPACE_INDEXING_HPP_
+#define CPP_PUBSUB__WORKSPACE_INDEXING_HPP_
+
+#include <cmath>
+
+
+/////////////////// clutching & rate-control workspace indexing ///////////////////
+// - while the clutch is held, the robot-frame target stays frozen and the operator can re-position the device
+// - on release, the offset is re-baselined so the target continues from where it was frozen (no jump)
+// - optionally, pushing the device beyond rate_zone [cm] on an axis drifts the target along that axis
+//   (rate control), which extends the reach beyond {device workspace} x {mapping ratio}
+struct IndexingSettings
+{
+  bool clutch {false};
+  double rate_zone {0.0};   // start of the rate-control zone in device coordinates [cm], 0 = disabled
+  double rate_gain {0.0};   // robot target speed per cm of zone penetration [m/s per cm]
+};
+
+class WorkspaceIndexing
+{
+public:
+
+  // button edge handling, mapped = latest device position mapped into the robot frame [m]
+  void set_button(bool pressed, const double * mapped, const IndexingSettings & s)
+  {
+    if (!s.clutch) return;
+    if (pressed && !clutched_) {
+      clutched_ = true;
+    } else if (!pressed && clutched_) {
+      for (int i=0; i<3; i++) offset_[i] = target_[i] - mapped[i];
+      clutched_ = false;
+    }
+  }
+
+  // device = raw device position [cm], mapped = the same position mapped into the robot frame [m]
+  // writes the robot-frame target into target, which is left untouched while clutched
+  void update(const double * device, const double * mapped, double dt, const IndexingSettings & s, double * target)
+  {
+    if (!clutched_) {
+      if (s.rate_zone > 0.0) {
+        for (int i=0; i<3; i++) {
+          double excess = std::abs(device[i]) - s.rate_zone;
+          if (excess > 0.0) offset_[i] += std::copysign(s.rate_gain * excess * dt, device[i]);
+        }
+      }
+      for (int i=0; i<3; i++) target_[i] = mapped[i] + offset_[i];
+    }
+    for (int i=0; i<3; i++) target[i] = target_[i];
+  }
+
+  bool clutched() const { return clutched_; }
+
+private:
+
+  bool clutched_ {false};
+  double offset_[3] {0.0, 0.0, 0.0};
+  double target_[3] {0.0, 0.0, 0.0};
+};
+
+
+#endif  // CPP_PUBSUB__WORKSPACE_INDEXING_HPP_
@@ -0,0 +1,116 @@
+# Falcon / recorder side of real.launch.py with a CPU placement profile (config/placement_profiles.yaml)
+#   ros2 launch cpp_pubsub real_rt.launch.py profile:=isolated [start_controller:=true] [start_markers:=true]
+# Start the robot bringup (joint_trajectory_controller) first, its ros2_control_node is pinned by pid here.
+# Without start_controller, run the controller with the same placement by hand, e.g. for "isolated":
+#   taskset -c 2 ros2 run cpp_pubsub real_controller --ros-args -p rt_cpus:=2 -p rt_priority:=80 -p rt_lock_memory:=1
+
+import os
+import yaml
+
+from ament_index_python.packages import get_package_share_directory
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument, ExecuteProcess, OpaqueFunction, TimerAction
+from launch.conditions import IfCondition
+from launch.substitutions import LaunchConfiguration
+from launch_ros.actions import Node
+from launch_ros.parameter_descriptions import ParameterValue
+
+
+PROFILES_FILE = os.path.join(get_package_share_directory('cpp_pubsub'), 'config', 'placement_profiles.yaml')
+ORIGIN_FILE = os.path.join(get_package_share_directory('cpp_pubsub'), 'config', 'origin.yaml')
+
+
+
+##############################################################################
+def taskset_prefix(placement):
+    cpus = str(placement.get('cpus', ''))
+    return 'taskset -c ' + cpus if cpus else ''
+
+
+##############################################################################
+def rt_params(placement):
+    # rt_cpus is a string parameter, a plain "2" would be YAML-evaluated to an integer by launch_ros
+    return {'rt_cpus': ParameterValue(str(placement.get('cpus', '')), value_type=str),
+            'rt_priority': int(placement.get('priority', 0)),
+            'rt_lock_memory': int(placement.get('lock_memory', 0))}
+
+
+##############################################################################
+def pin_running_process(pattern, placement):
+    # applies affinity / FIFO priority to every thread of an already running process and prints the result
+    cmds = []
+    cpus = str(placement.get('cpus', ''))
+    priority = int(placement.get('priority', 0))
+    if cpus: cmds.append('taskset -a -cp ' + cpus + ' $p')
+    if priority > 0: cmds.append('chrt -a -f -p ' + str(priority) + ' $p')
+    if not cmds:
+        return []
+    # the bracket keeps pgrep from matching this sh -c command line itself
+    script = ('pids=$(pgrep -f "[' + pattern[0] + ']' + pattern[1:] + '"); '
+              'if [ -z "$pids" ]; then echo "Real-time placement [' + pattern + ']: process not found, start the robot bringup first"; exit 0; fi; '
+              'for p in $pids; do ' + ' && '.join(cmds) + ' >/dev/null '
+              '&& echo "Real-time placement [' + pattern + ' $p]: [OK] $(taskset -cp $p | cut -d: -f2) $(chrt -p $p | tail -n 1)" '
+              '|| echo "Real-time placement [' + pattern + ' $p]: [NOT GRANTED] (needs CAP_SYS_NICE)"; done')
+    return [ExecuteProcess(cmd=['sh', '-c', script], output='screen')]
+
+
+##############################################################################
+def launch_setup(context):
+    profile_name = LaunchConfiguration('profile').perform(context)
+    with open(PROFILES_FILE) as f:
+        profiles = yaml.safe_load(f)
+    if profile_name not in profiles:
+        raise RuntimeError('Unknown placement profile "' + profile_name + '", available: ' + ', '.join(profiles))
+    profile = profiles[profile_name]
+    print('\nUsing placement profile "' + profile_name + '"\n')
+
+    position_talker = Node(
+        package='cpp_pubsub',
+        executable='position_talker',
+        prefix=taskset_prefix(profile['position_talker']),
+        parameters=[rt_params(profile['position_talker'])],
+        output='screen',
+        emulate_tty=True,
+    )
+
+    traj_recorder = Node(
+        package='cpp_pubsub',
+        executable='traj_recorder.py',
+        prefix=taskset_prefix(profile['traj_recorder']),
+        output='screen',
+        emulate_tty=True,
+    )
+
+    real_controller = Node(
+        package='cpp_pubsub',
+        executable='real_controller',
+        prefix=taskset_prefix(profile['real_controller']),
+        parameters=[ORIGIN_FILE, rt_params(profile['real_controller'])],
+        output='screen',
+        emulate_tty=True,
+        condition=IfCondition(LaunchConfiguration('start_controller')),
+    )
+
+    marker_publisher = Node(
+        package='cpp_pubsub',
+        executable='marker_publisher',
+        prefix=taskset_prefix(profile['marker_publisher']),
+        parameters=[ORIGIN_FILE],
+        output='screen',
+        condition=IfCondition(LaunchConfiguration('start_markers')),
+    )
+
+    # give the robot bringup a moment in case both were started together
+    pin_control_node = TimerAction(period=2.0, actions=pin_running_process('ros2_control_node', profile['ros2_control_node']))
+
+    return [position_talker, traj_recorder, real_controller, marker_publisher, pin_control_node]
+
+
+##############################################################################
+def generate_launch_description():
+    return LaunchDescription([
+        DeclareLaunchArgument('profile', default_value='isolated', description='placement profile in config/placement_profiles.yaml'),
+        DeclareLaunchArgument('start_controller', default_value='false', description='also start real_controller'),
+        DeclareLaunchArgument('start_markers', default_value='false', description='also start marker_publisher'),
+        OpaqueFunction(function=launch_setup),
+    ])
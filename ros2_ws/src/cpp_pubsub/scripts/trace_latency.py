@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+
+# Per-stage latency breakdown of the teleoperation pipeline from an LTTng trace of the hri:* tracepoints.
+# The nodes have to be built with -DHRI_TRACING=ON, then:
+#   lttng create hri && lttng enable-event -u 'hri:*' && lttng start
+#   ... run position_talker and real_controller ...
+#   lttng stop && lttng destroy
+#   ros2 run cpp_pubsub trace_latency.py ~/lttng-traces/hri-<date>
+
+import sys
+import bisect
+
+import numpy as np
+import bt2
+
+
+STAGES = [
+    ("falcon read -> publish",        "talker processing (filtering)"),
+    ("falcon publish -> receive",     "transport"),
+    ("falcon receive -> IK start",    "sample waiting for a control tick"),
+    ("IK start -> IK end",            "inverse kinematics"),
+    ("IK end -> command publish",     "blending, limits, publish"),
+    ("command publish -> joint state", "robot round trip"),
+    ("falcon read -> command publish", "end to end"),
+]
+
+
+
+##############################################################################
+def read_events(trace_path):
+    events = {}
+    for msg in bt2.TraceCollectionMessageIterator(trace_path):
+        if type(msg) is not bt2._EventMessageConst:
+            continue
+        name = msg.event.name
+        if not name.startswith("hri:"):
+            continue
+        t = msg.default_clock_snapshot.ns_from_origin
+        fields = {k: v for k, v in msg.event.payload_field.items()}
+        events.setdefault(name[4:], []).append((t, fields))
+    return events
+
+
+##############################################################################
+def latest_before(times, t):
+    # index of the last entry of the sorted list times that is <= t, or -1
+    return bisect.bisect_right(times, t) - 1
+
+
+##############################################################################
+def breakdown(events):
+    lat = {name: [] for name, _ in STAGES}
+
+    reads = {int(f["seq"]): t for t, f in events.get("falcon_read", [])}
+    publishes = events.get("falcon_publish", [])
+    receives = events.get("falcon_receive", [])
+    ik_start = {int(f["tick"]): t for t, f in events.get("ik_start", [])}
+    ik_end = {int(f["tick"]): t for t, f in events.get("ik_end", [])}
+    commands = {int(f["tick"]): t for t, f in events.get("command_publish", [])}
+    joint_times = sorted(t for t, _ in events.get("joint_state_receive", []))
+
+    # talker processing, by sample sequence number
+    for t, f in publishes:
+        seq = int(f["seq"])
+        if seq in reads: lat["falcon read -> publish"].append(t - reads[seq])
+
+    # transport, matched by the published position (first receive of the same values after the publish)
+    pending = {}
+    for t, f in publishes:
+        pending.setdefault((f["x"], f["y"], f["z"]), []).append((t, int(f["seq"])))
+    received = []   # (receive time, read time) of matched samples, in receive order
+    for t, f in receives:
+        queue = pending.get((f["x"], f["y"], f["z"]), [])
+        while queue and queue[0][0] <= t:
+            t_pub, seq = queue.pop(0)
+            if queue and queue[0][0] <= t: continue   # a newer identical sample was already out, use that one
+            lat["falcon publish -> receive"].append(t - t_pub)
+            if seq in reads: received.append((t, reads[seq]))
+            break
+
+    # the controller tick consumes the most recent sample received before its IK starts
+    receive_times = [t for t, _ in received]
+    for tick, t0 in ik_start.items():
+        k = latest_before(receive_times, t0)
+        if k >= 0:
+            lat["falcon receive -> IK start"].append(t0 - receive_times[k])
+            if tick in commands: lat["falcon read -> command publish"].append(commands[tick] - received[k][1])
+        if tick in ik_end:
+            lat["IK start -> IK end"].append(ik_end[tick] - t0)
+            if tick in commands: lat["IK end -> command publish"].append(commands[tick] - ik_end[tick])
+
+    # first joint state after each command
+    for t in commands.values():
+        k = bisect.bisect_right(joint_times, t)
+        if k < len(joint_times): lat["command publish -> joint state"].append(joint_times[k] - t)
+
+    return lat
+
+
+##############################################################################
+def print_table(lat):
+    print("\n%-32s %-36s %8s %10s %10s %10s %10s" % ("stage", "", "count", "mean[us]", "p50[us]", "p99[us]", "max[us]"))
+    print("-" * 122)
+    for name, desc in STAGES:
+        d = np.array(lat[name], dtype=float) / 1000.0
+        if len(d) == 0:
+            print("%-32s %-36s %8d %10s %10s %10s %10s" % (name, desc, 0, "-", "-", "-", "-"))
+            continue
+        print("%-32s %-36s %8d %10.1f %10.1f %10.1f %10.1f" % (name, desc, len(d), d.mean(), np.percentile(d, 50), np.percentile(d, 99), d.max()))
+    print()
+
+
+
+##############################################################################
+def main():
+    if len(sys.argv) != 2:
+        print("usage: trace_latency.py <lttng trace directory>")
+        sys.exit(1)
+    events = read_events(sys.argv[1])
+    if not events:
+        print("No hri:* events found, were the nodes built with -DHRI_TRACING=ON ?")
+        sys.exit(1)
+    print_table(breakdown(events))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "cpp_pubsub/falcon_correction.hpp"
+
+#include <stdio.h>
+#include "dhdc.h"
+
+
+/////////////////// global variables ///////////////////
+const std::string calibration_dir = "/home/michael/HRI/ros2_ws/src/cpp_pubsub/config/";
+
+
+/////////////////// Falcon correction table calibration ///////////////////
+// 1. the handle is placed on every point of a calibration jig (known positions in the Falcon frame [m], one
+//    "x y z" per line of jig_file) and the button is pressed; the measured position is averaged over hold_time
+// 2. all (measured, true) pairs are written to samples_file
+// 3. the correction grid is fitted to them (see fit_correction_grid) and written to output, which is the
+//    correction_file parameter of position_talker
+// With fit_only:=1 steps 1 and 2 are skipped and the grid is re-fitted from an existing samples_file (no device needed).
+class FalconCalibration : public rclcpp::Node
+{
+public:
+
+  // parameters name list
+  std::vector<std::string> param_names = {"jig_file", "samples_file", "output", "fit_only", "grid_size", "grid_half_width",
+                                          "kernel_width", "regularization", "hold_time"};
+  std::string jig_file {calibration_dir + "falcon_jig.txt"};
+  std::string samples_file {calibration_dir + "falcon_samples.txt"};
+  std::string output {calibration_dir + "falcon_correction.txt"};
+  int fit_only {0};
+  int grid_size {9};
+  double grid_half_width {0.06};    // [m], covers the Falcon workspace (about +-5 cm)
+  double kernel_width {0.015};      // [m]
+  double regularization {0.001};
+  double hold_time {0.5};           // [s]
+
+  const double sample_period = 0.002;   // [s]
+
+
+  FalconCalibration()
+  : Node("falcon_calibration")
+  {
+    // parameter stuff
+    this->declare_parameter(param_names.at(0), jig_file);
+    this->declare_parameter(param_names.at(1), samples_file);
+    this->declare_parameter(param_names.at(2), output);
+    this->declare_parameter(param_names.at(3), fit_only);
+    this->declare_parameter(param_names.at(4), grid_size);
+    this->declare_parameter(param_names.at(5), grid_half_width);
+    this->declare_parameter(param_names.at(6), kernel_width);
+    this->declare_parameter(param_names.at(7), regularization);
+    this->declare_parameter(param_names.at(8), hold_time);
+
+    std::vector<rclcpp::Parameter> params = this->get_parameters(param_names);
+    jig_file = params.at(0).value_to_string();
+    samples_file = params.at(1).value_to_string();
+    output = params.at(2).value_to_string();
+    fit_only = std::stoi(params.at(3).value_to_string().c_str());
+    grid_size = std::max(2, std::stoi(params.at(4).value_to_string().c_str()));
+    grid_half_width = std::stod(params.at(5).value_to_string().c_str());
+    kernel_width = std::stod(params.at(6).value_to_string().c_str());
+    regularization = std::stod(params.at(7).value_to_string().c_str());
+    hold_time = std::stod(params.at(8).value_to_string().c_str());
+    print_params();
+  }
+
+  bool run()
+  {
+    std::vector<CorrectionSample> samples;
+    if (fit_only == 0) {
+      if (!record_samples(samples)) return false;
+    } else if (!load_correction_samples(samples_file, samples)) {
+      std::cout << "Could not read the samples file " << samples_file << std::endl;
+      return false;
+    }
+    if (samples.empty()) {
+      std::cout << "No calibration samples, nothing to fit" << std::endl;
+      return false;
+    }
+
+    CorrectionGrid grid;
+    for (int a=0; a<3; a++) {
+      grid.min[a] = -grid_half_width;
+      grid.max[a] = grid_half_width;
+      grid.size[a] = grid_size;
+    }
+    fit_correction_grid(samples, kernel_width, regularization, grid);
+
+    // residuals of the fitted table on the samples themselves
+    FalconCorrection correction;
+    correction.configure(grid);
+    double before = 0.0, after = 0.0, worst = 0.0;
+    for (const auto & s : samples) {
+      double p[3] {s.measured[0], s.measured[1], s.measured[2]};
+      correction.correct(p);
+      double e0 = 0.0, e1 = 0.0;
+      for (int a=0; a<3; a++) {
+        e0 += (s.truth[a] - s.measured[a]) * (s.truth[a] - s.measured[a]);
+        e1 += (s.truth[a] - p[a]) * (s.truth[a] - p[a]);
+      }
+      before += e0;
+      after += e1;
+      worst = std::max(worst, std::sqrt(e1));
+    }
+    std::cout << samples.size() << " samples: RMS error " << std::sqrt(before / samples.size()) * 1000 << " [mm] uncorrected, "
+              << std::sqrt(after / samples.size()) * 1000 << " [mm] corrected (worst " << worst * 1000 << " [mm])\n" << std::endl;
+
+    if (!save_correction_grid(output, grid)) {
+      std::cout << "Could not write " << output << std::endl;
+      return false;
+    }
+    std::cout << "Correction table written to " << output << " (pass it as correction_file to position_talker)\n" << std::endl;
+    return true;
+  }
+
+private:
+
+  bool record_samples(std::vector<CorrectionSample> & samples)
+  {
+    std::vector<std::vector<double>> jig;
+    std::ifstream file(jig_file);
+    std::string line;
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#') continue;
+      std::stringstream ss(line);
+      double x, y, z;
+      if (ss >> x >> y >> z) jig.push_back({x, y, z});
+    }
+    if (jig.empty()) {
+      std::cout << "No jig points in " << jig_file << std::endl;
+      return false;
+    }
+
+    std::ofstream out(samples_file);
+    if (!out.is_open()) {
+      std::cout << "Could not write the samples file " << samples_file << std::endl;
+      return false;
+    }
+    out.precision(8);
+    out << "# measured x y z, true x y z [m]\n";
+
+    int hold_samples = std::max(1, (int) (hold_time / sample_period));
+    for (size_t k=0; k<jig.size(); k++) {
+      printf("Point %zu / %zu: place the handle on (%.4f, %.4f, %.4f) [m] and press the button ('q' to stop)\n",
+             k + 1, jig.size(), jig[k][0], jig[k][1], jig[k][2]);
+
+      // wait for the button, keep the device force-free meanwhile
+      while (dhdGetButton(0) != DHD_ON) {
+        dhdSetForceAndTorqueAndGripperForce(0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+        if (dhdKbHit() && dhdKbGet() == 'q') return true;
+        dhdSleep(sample_period);
+      }
+
+      CorrectionSample s {};
+      for (int n=0; n<hold_samples; n++) {
+        double p[3];
+        dhdSetForceAndTorqueAndGripperForce(0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+        dhdGetPosition(&(p[0]), &(p[1]), &(p[2]));
+        for (int a=0; a<3; a++) s.measured[a] += p[a] / hold_samples;
+        dhdSleep(sample_period);
+      }
+      for (int a=0; a<3; a++) s.truth[a] = jig[k][a];
+      samples.push_back(s);
+      out << s.measured[0] << " " << s.measured[1] << " " << s.measured[2] << " "
+          << s.truth[0] << " " << s.truth[1] << " " << s.truth[2] << std::endl;
+      printf("   measured (%.4f, %.4f, %.4f), error %.2f [mm]\n", s.measured[0], s.measured[1], s.measured[2],
+             1000 * std::sqrt(std::pow(s.truth[0] - s.measured[0], 2) + std::pow(s.truth[1] - s.measured[1], 2) + std::pow(s.truth[2] - s.measured[2], 2)));
+
+      // wait for the release, so one press is one point
+      while (dhdGetButton(0) == DHD_ON) {
+        dhdSetForceAndTorqueAndGripperForce(0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+        dhdSleep(sample_period);
+      }
+    }
+    std::cout << "\nSamples written to " << samples_file << "\n" << std::endl;
+    return true;
+  }
+
+  void print_params() {
+    for (unsigned int i=0; i<10; i++) std::cout << "\n";
+    std::cout << "\n\nThe current parameters [falcon_calibration] are as follows:\n" << std::endl;
+    std::cout << "Jig file = " << jig_file << "\n" << std::endl;
+    std::cout << "Samples file = " << samples_file << " (fit only = " << fit_only << ")\n" << std::endl;
+    std::cout << "Output = " << output << "\n" << std::endl;
+    std::cout << "Grid = " << grid_size << "^3 nodes over +-" << grid_half_width << " [m], kernel width = " << kernel_width
+              << " [m], regularization = " << regularization << "\n" << std::endl;
+    for (unsigned int i=0; i<10; i++) std::cout << "\n";
+  }
+};
+
+
+//////////////////// MAIN FUNCTION ///////////////////
+
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  auto node = std::make_shared<FalconCalibration>();
+
+  bool device = node->fit_only == 0;
+  if (device) {
+    // open the first available device, force-free with button emulation like position_talker
+    if (dhdOpen () < 0) {
+      printf ("error: cannot open device (%s)\n", dhdErrorGetLastStr());
+      dhdSleep (2.0);
+      rclcpp::shutdown();
+      return -1;
+    }
+    printf ("%s device detected\n\n", dhdGetSystemName());
+    dhdEnableExpertMode ();
+    dhdSetVelocityThreshold (0);
+    dhdEnableForce (DHD_ON);
+    dhdEmulateButton (DHD_ON);
+  }
+
+  bool ok = node->run();
+
+  if (device) dhdClose ();
+  rclcpp::shutdown();
+  return ok ? 0 : 1;
+}
@@ -109,6 +109,11 @@ public:
   GazeboController()
   : Node("gazebo_controller")
   { 
+    // task-space origin, can be overridden from the shared config/origin.yaml
+    this->declare_parameter("origin", origin);
+    std::vector<double> origin_param = this->get_parameter("origin").as_double_array();
+    if (origin_param.size() == 3) origin = origin_param;
+
     // joint controller publisher & timer
     controller_pub_ = this->create_publisher<trajectory_msgs::msg::JointTrajectory>("joint_trajectory_controller/joint_trajectory", 10);
     controller_timer_ = this->create_wall_timer(50ms, std::bind(&GazeboController::controller_publisher, this));    // controls at 20 Hz 
@@ -0,0 +1,4 @@
+// instantiates the "hri" tracepoint provider, linked into each traced node when HRI_TRACING is ON
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+#include "cpp_pubsub/hri_tracepoints.h"
@@ -1,11 +1,14 @@
 #include <chrono>
 #include <functional>
+#include <algorithm>
 #include <cmath>
 #include <memory>
 #include <string>
 
 #include "rclcpp/rclcpp.hpp"
 #include "std_msgs/msg/float64.hpp"
+#include "std_msgs/msg/float64_multi_array.hpp"
+#include "std_msgs/msg/color_rgba.hpp"
 #include "geometry_msgs/msg/point.hpp"
 #include "visualization_msgs/msg/marker.hpp"
 #include "visualization_msgs/msg/marker_array.hpp"
@@ -13,6 +16,9 @@
 #include "tutorial_interfaces/msg/falconpos.hpp"
 #include "tutorial_interfaces/msg/pos_info.hpp"
 
+#include "cpp_pubsub/reference_trajectory.hpp"
+#include "cpp_pubsub/task_origin.hpp"
+
 using namespace std::chrono_literals;
 
 
@@ -22,9 +28,13 @@ void generate_ref_ball(visualization_msgs::msg::Marker &ref_marker, double x, do
 
 void generate_tcp_marker(visualization_msgs::msg::Marker &tcp_marker);
 visualization_msgs::msg::Marker generate_countdown(int count, std::vector<double> &center);
+visualization_msgs::msg::Marker generate_score_text(double score, double recent_score, bool final, std::vector<double> &center);
 
 void generate_traj_marker(visualization_msgs::msg::Marker &traj_marker, std::vector<double> &origin, int max_points,
-                          double pa, double pb, double pc, double ps, double ph, double height, double width, double depth, int use_depth);
+                          const ReferenceTrajectory &reference);
+
+void init_preview_marker(visualization_msgs::msg::Marker &preview_marker, int max_vertices,
+                         std::vector<std_msgs::msg::ColorRGBA> &preview_colors);
 
 
 class MarkerPublisher : public rclcpp::Node
@@ -32,11 +42,13 @@ class MarkerPublisher : public rclcpp::Node
   public:
 
     // parameters name list
-    std::vector<std::string> param_names = {"use_depth", "part_id", "alpha_id", "traj_id"};
+    std::vector<std::string> param_names = {"use_depth", "part_id", "alpha_id", "traj_id", "arc_length", "preview_time"};
     int use_depth {0};
     int part_id {0};
     int alpha_id {0};
     int traj_id {0};
+    int arc_length {0};   // must match the real controller, it changes where the reference is at a given time
+    double preview_time {2.0};   // seconds of the upcoming reference shown ahead of the ball, 0 disables the preview
     
      //////// KEEP CONSISTENT WITH REAL CONTROLLER ////////
     std::vector<double> origin {0.5059, 0.0, 0.4346};
@@ -58,16 +70,27 @@ class MarkerPublisher : public rclcpp::Node
     int controller_seconds {0};
     int countdown_count {5};
 
-    // sine curve parameters (initialization)
-    int pa = 0;
-    int pb = 0;
-    int pc = 0;
-    double ps = 0.0;
-    double ph = 0.0;
-    
-    double traj_height = 0.1;
-    double traj_width = 0.3;
-    double traj_depth = 0.1;
+    // latest tracking score from the controller {score, recent score, ...}, see RealController::publish_tracking_score
+    bool got_score = false;
+    bool final_score = false;
+    double score = 0.0;
+    double recent_score = 0.0;
+
+    // sine curve parameters and the same per-tick reference table the real controller builds
+    SineSumParams traj_params;
+    ReferenceTrajectory reference;
+
+    // preview window: one vertex every preview_step ticks of the reference table, plus the current reference
+    // position as the first vertex; vertices are only dropped / appended as the window slides
+    const int preview_step = 20;   // 40 ms
+    int preview_ticks = 0;
+    int preview_first = 0;    // table vertex index of points[1]
+    int preview_last = -1;    // table vertex index of points.back()
+    std::vector<std_msgs::msg::ColorRGBA> preview_colors;   // fades out towards the end of the window
+
+    // reference tick of the last tcp_position message (time_from_start is tick based), the same tick the ball is
+    // drawn from, so the preview starts exactly at the ball
+    int last_reference_tick = 0;
   
 
     MarkerPublisher()
@@ -78,26 +101,42 @@ class MarkerPublisher : public rclcpp::Node
       this->declare_parameter(param_names.at(1), 0);
       this->declare_parameter(param_names.at(2), 0);
       this->declare_parameter(param_names.at(3), 0);
+      this->declare_parameter(param_names.at(4), 0);
+      this->declare_parameter(param_names.at(5), preview_time);
+      this->declare_parameter("origin", origin);
+      this->declare_parameter("traj_origins", std::vector<double> {});
       
       std::vector<rclcpp::Parameter> params = this->get_parameters(param_names);
       use_depth = std::stoi(params.at(0).value_to_string().c_str());
       part_id = std::stoi(params.at(1).value_to_string().c_str());
       alpha_id = std::stoi(params.at(2).value_to_string().c_str());
       traj_id = std::stoi(params.at(3).value_to_string().c_str());
+      arc_length = std::stoi(params.at(4).value_to_string().c_str());
+      preview_time = std::stod(params.at(5).value_to_string().c_str());
+      std::vector<double> origin_param = this->get_parameter("origin").as_double_array();
+      if (origin_param.size() == 3) origin = origin_param;
+      // the origin of this trajectory, chosen the same way as in the real controller
+      TaskOrigins task_origins;
+      if (!task_origins.configure(origin, this->get_parameter("traj_origins").as_double_array())) {
+        std::cout << "WARNING: traj_origins does not have an origin for all " << TaskOrigins::num_trajs << " trajectories, "
+                  << "it is ignored and the shared origin is used\n" << std::endl;
+      }
+      task_origins.get(traj_id, origin.data());
       print_params();
 
-      // write the sine curve parameters
-      switch (traj_id) {
-        case 0: pa = 1; pb = 1; pc = 4; ps = M_PI;     ph = 0.25; break;
-        case 1: pa = 2; pb = 3; pc = 4; ps = 4*M_PI/3; ph = 0.25; break;
-        case 2: pa = 1; pb = 3; pc = 4; ps = M_PI;     ph = 0.25; break;
-        case 3: pa = 2; pb = 2; pc = 5; ps = M_PI;     ph = 0.2; break;
-        case 4: pa = 2; pb = 3; pc = 5; ps = 8*M_PI/5; ph = 0.2; break;
-        case 5: pa = 2; pb = 4; pc = 5; ps = M_PI;     ph = 0.2; break;
-      }
+      // write the sine curve parameters and sample the reference for every controller tick of the recording
+      get_sine_sum_params(traj_id, traj_params);
+      traj_params.use_depth = use_depth;
+      const SineSumParams & tp = traj_params;
+      reference.build([&tp](double t, double * xyz) { sine_sum_offset(tp, t, xyz); }, control_freq * max_recording_time, arc_length == 1);
 
       // generate the trajectory marker
-      generate_traj_marker(traj_marker_, origin, max_points, pa, pb, pc, ps, ph, traj_height, traj_width, traj_depth, use_depth);
+      generate_traj_marker(traj_marker_, origin, max_points, reference);
+
+      // the preview starts at the beginning of the reference until the first tcp_position message arrives
+      preview_ticks = std::max(0, (int) (preview_time * control_freq));
+      init_preview_marker(preview_marker_, preview_ticks / preview_step + 1, preview_colors);
+      update_preview(0);
 
       // create the marker publisher
       marker_timer_ = this->create_wall_timer(20ms, std::bind(&MarkerPublisher::marker_callback, this));  // publish this at 50 Hz
@@ -109,6 +148,9 @@ class MarkerPublisher : public rclcpp::Node
 
       count_sub_ = this->create_subscription<std_msgs::msg::Float64>(
       "countdown", 10, std::bind(&MarkerPublisher::count_callback, this, std::placeholders::_1));
+
+      score_sub_ = this->create_subscription<std_msgs::msg::Float64MultiArray>(
+      "tracking_score", 10, std::bind(&MarkerPublisher::score_callback, this, std::placeholders::_1));
     }
 
 
@@ -121,6 +163,12 @@ class MarkerPublisher : public rclcpp::Node
       // add in the certain ones
       marker_array_msg.markers.push_back(traj_marker_);
 
+      if (preview_ticks > 0) {
+        update_preview(last_reference_tick);
+        preview_marker_.header.stamp = this->now();
+        marker_array_msg.markers.push_back(preview_marker_);
+      }
+
       generate_tcp_marker(tcp_marker_);
       marker_array_msg.markers.push_back(tcp_marker_);
       
@@ -134,6 +182,11 @@ class MarkerPublisher : public rclcpp::Node
         auto countdown_text = generate_countdown(countdown_count, bar_center);
         marker_array_msg.markers.push_back(countdown_text);
       }
+
+      // running tracking score above the countdown, the final one stays up after the trial
+      if (got_score) {
+        marker_array_msg.markers.push_back(generate_score_text(score, recent_score, final_score, bar_center));
+      }
       
       marker_pub_->publish(marker_array_msg);
 
@@ -144,6 +197,45 @@ class MarkerPublisher : public rclcpp::Node
       ref_pos.at(0) = msg.ref_position[0];
       ref_pos.at(1) = msg.ref_position[1];
       ref_pos.at(2) = msg.ref_position[2];
+
+      last_reference_tick = std::clamp((int) std::lround(msg.time_from_start * control_freq), 0, reference.num_ticks());
+    }
+
+    // slide the preview window to [tick, tick + preview_ticks], touching only the vertices that left / entered it
+    void update_preview(int tick)
+    {
+      auto & points = preview_marker_.points;
+      int first = tick / preview_step + 1;
+      int last = std::min((tick + preview_ticks) / preview_step, reference.num_ticks() / preview_step);
+
+      if (first < preview_first) {
+        // time went backwards (new trial), start over
+        points.resize(1);
+        preview_first = first;
+        preview_last = first - 1;
+      }
+      int drop = std::min(first - preview_first, (int) points.size() - 1);
+      points.erase(points.begin() + 1, points.begin() + 1 + drop);
+      preview_first = first;
+      preview_last = std::max(preview_last, first - 1);
+
+      while (preview_last < last) {
+        preview_last++;
+        points.push_back(reference_point(preview_last * preview_step));
+      }
+      points.at(0) = reference_point(tick);
+
+      preview_marker_.colors.assign(preview_colors.begin(), preview_colors.begin() + points.size());
+    }
+
+    geometry_msgs::msg::Point reference_point(int tick) const
+    {
+      const double * offset = reference.offset_at(tick);
+      geometry_msgs::msg::Point p;
+      p.x = origin.at(0) + offset[0];
+      p.y = origin.at(1) + offset[1];
+      p.z = origin.at(2) + offset[2];
+      return p;
     }
 
     void count_callback(const std_msgs::msg::Float64 & msg) {
@@ -153,6 +245,14 @@ class MarkerPublisher : public rclcpp::Node
       }
     }
 
+    void score_callback(const std_msgs::msg::Float64MultiArray & msg) {
+      if (msg.data.size() < 7) return;
+      score = msg.data[0];
+      recent_score = msg.data[1];
+      final_score = msg.data[6] != 0.0;
+      got_score = true;
+    }
+
     void print_params() {
       for (unsigned int i=0; i<10; i++) std::cout << "\n";
       std::cout << "\n\nThe current parameters [marker_publisher] are as follows:\n" << std::endl;
@@ -160,6 +260,8 @@ class MarkerPublisher : public rclcpp::Node
       std::cout << "Participant ID = " << part_id << "\n" << std::endl;
       std::cout << "Alpha ID = " << alpha_id << "\n" << std::endl;
       std::cout << "Trajectory ID = " << traj_id << "\n" << std::endl;
+      std::cout << "Origin = {" << origin.at(0) << ", " << origin.at(1) << ", " << origin.at(2) << "}\n" << std::endl;
+      std::cout << "Arc length = " << arc_length << ", preview time = " << preview_time << " [s]\n" << std::endl;
       for (unsigned int i=0; i<10; i++) std::cout << "\n";
     }
 
@@ -168,8 +270,10 @@ class MarkerPublisher : public rclcpp::Node
 
     rclcpp::Subscription<tutorial_interfaces::msg::PosInfo>::SharedPtr ref_sub_;
     rclcpp::Subscription<std_msgs::msg::Float64>::SharedPtr count_sub_;
+    rclcpp::Subscription<std_msgs::msg::Float64MultiArray>::SharedPtr score_sub_;
 
     visualization_msgs::msg::Marker traj_marker_;
+    visualization_msgs::msg::Marker preview_marker_;
     visualization_msgs::msg::Marker ref_marker_;
     visualization_msgs::msg::Marker tcp_marker_;
     
@@ -285,9 +389,42 @@ visualization_msgs::msg::Marker generate_countdown(int count, std::vector<double
 }
 
 
+/////////////////////////////////// FUNCTIONS TO GENERATE SCORE TEXT ///////////////////////////////////
+visualization_msgs::msg::Marker generate_score_text(double score, double recent_score, bool final, std::vector<double> &center)
+{
+  auto text = visualization_msgs::msg::Marker();
+
+  // fill-in the text message
+  text.header.frame_id = "/panda_link0";
+  text.header.stamp = rclcpp::Clock().now();
+  text.ns = "marker_publisher";
+  text.action = visualization_msgs::msg::Marker::ADD;
+  text.id = 11;
+  text.type = visualization_msgs::msg::Marker::TEXT_VIEW_FACING;
+
+  // height of 'A' is 8 cm
+  text.scale.z = 0.08;
+
+  // red (poor) to green (good), following the last second while tracking and the whole trial at the end
+  double s = std::clamp((final ? score : recent_score) / 100.0, 0.0, 1.0);
+  text.color.r = 1.0 - s;
+  text.color.g = s;
+  text.color.a = 1.0;
+
+  text.text = (final ? "Final score: " : "Score: ") + std::to_string((int) std::round(score));
+
+  // above the countdown
+  text.pose.position.x = center.at(0);
+  text.pose.position.y = center.at(1);
+  text.pose.position.z = center.at(2) + 0.3;
+
+  return text;
+}
+
+
 /////////////////////////////////// FUNCTIONS TO GENERATE REFERENCE TRAJECTORY MARKERS ///////////////////////////////////
 void generate_traj_marker(visualization_msgs::msg::Marker &traj_marker, std::vector<double> &origin, int max_points,
-                          double pa, double pb, double pc, double ps, double ph, double height, double width, double depth, int use_depth)
+                          const ReferenceTrajectory &reference)
 {
   // fill-in the traj_marker message
   traj_marker.header.frame_id = "/panda_link0";
@@ -304,27 +441,50 @@ void generate_traj_marker(visualization_msgs::msg::Marker &traj_marker, std::vec
   traj_marker.color.b = 1.0;
   traj_marker.color.a = 0.2;
 
-  // Create the vertices for the points and lines
+  // Create the vertices for the points and lines, evenly spaced in time along the reference table
   for (int count=0; count<=max_points; count++) {
 
-    double t = (double) count / max_points * 2 * M_PI;   // parametrized in the range [0, 2pi]
-
-    double x = 0.0;
-    if (use_depth) x = abs(t-M_PI) / M_PI * depth - (depth/2);
-    
-    double y = t / (2*M_PI) * width - (width/2);
-    double z = (ph*height) * (sin(pa*(t+ps)) + sin(pb*(t+ps)) + sin(pc*(t+ps)));
+    const double * offset = reference.offset_at((int) std::lround((double) count / max_points * reference.num_ticks()));
 
     geometry_msgs::msg::Point p;
-    p.x = x + origin.at(0);
-    p.y = y + origin.at(1);
-    p.z = z + origin.at(2);
+    p.x = offset[0] + origin.at(0);
+    p.y = offset[1] + origin.at(1);
+    p.z = offset[2] + origin.at(2);
 
     traj_marker.points.push_back(p);
   }
 }
 
 
+/////////////////////////////////// FUNCTIONS TO GENERATE REFERENCE PREVIEW MARKER ///////////////////////////////////
+void init_preview_marker(visualization_msgs::msg::Marker &preview_marker, int max_vertices,
+                         std::vector<std_msgs::msg::ColorRGBA> &preview_colors)
+{
+  // fill-in the preview_marker message, the points are filled by MarkerPublisher::update_preview()
+  preview_marker.header.frame_id = "/panda_link0";
+  preview_marker.ns = "marker_publisher";
+  preview_marker.action = visualization_msgs::msg::Marker::ADD;
+  preview_marker.id = 3;
+  preview_marker.type = visualization_msgs::msg::Marker::LINE_STRIP;
+
+  // thinner than the full trajectory, drawn on top of it
+  preview_marker.scale.x = 0.008;
+
+  // green like the reference ball, per-vertex colors fading out towards the end of the window
+  preview_marker.color.g = 1.0;
+  preview_marker.color.a = 1.0;
+  preview_colors.resize(max_vertices + 1);
+  for (int i=0; i<=max_vertices; i++) {
+    preview_colors.at(i).g = 1.0;
+    preview_colors.at(i).a = 0.9 - 0.8 * i / std::max(max_vertices, 1);
+  }
+
+  preview_marker.points.reserve(max_vertices + 1);
+  preview_marker.colors.reserve(max_vertices + 1);
+  preview_marker.points.resize(1);
+}
+
+
 /////////////////////////// THE MAIN FUNCTION ///////////////////////////
 int main(int argc, char * argv[])
 {
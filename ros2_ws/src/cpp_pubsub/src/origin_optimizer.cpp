@@ -0,0 +1,398 @@
+#include "rclcpp/rclcpp.hpp"
+
+#include "cpp_pubsub/reference_trajectory.hpp"
+#include "cpp_pubsub/task_origin.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <kdl_parser/kdl_parser.hpp>
+#include <kdl/chain.hpp>
+#include <kdl/chainfksolverpos_recursive.hpp>
+#include <kdl/chainiksolverpos_nr.hpp>
+#include <kdl/chainiksolvervel_pinv.hpp>
+#include <kdl/chainjnttojacsolver.hpp>
+#include <kdl/frames.hpp>
+#include <kdl/jacobian.hpp>
+#include <kdl/jntarray.hpp>
+
+
+/////////////////// global variables ///////////////////
+//////// KEEP CONSISTENT WITH REAL CONTROLLER ////////
+const std::string urdf_path = "/home/michael/HRI/ros2_ws/src/cpp_pubsub/urdf/panda.urdf";
+const std::string origin_config_path = "/home/michael/HRI/ros2_ws/src/cpp_pubsub/config/origin.yaml";
+const unsigned int n_joints = 7;
+
+const std::vector<double> lower_joint_limits {-2.8973, -1.7628, -2.8973, -3.0718, -2.8973, -0.0175, -2.8973};
+const std::vector<double> upper_joint_limits {2.8973, 1.7628, 2.8973, -0.0698, 2.8973, 3.7525, 2.8973};
+const std::vector<double> home_joint_vals {0, -M_PI_4/2, 0, -5 * M_PI_4/2, 0, M_PI_2, M_PI_4};
+
+const int control_freq = 500;   // [Hz]
+const int traj_duration = 10;   // [s]
+
+
+/////////////////// origin search ///////////////////
+// Every candidate origin on a grid in the x-z plane (y = 0, the references are symmetric in y) is scored by solving
+// the IK, as the controller does (orientation held at the home pose, warm-started along the path), for
+//   - every selected reference, sampled along the trajectory
+//   - the expected human excursions around each sample, +-excursion along each axis
+// Each candidate gets two numbers, both worst cases over all points:
+//   margin            smallest distance to a joint limit, as a fraction of that joint's range
+//   manipulability    sqrt(det(J J^T)) of the 6x7 Jacobian (Yoshikawa)
+// A candidate with an IK failure or a limit violation is infeasible. The score of a feasible one is
+//   margin_weight * margin / best margin + (1 - margin_weight) * manipulability / best manipulability
+// The best candidate of the coarse grid is refined on a grid 4x finer around it. Candidates are spread over
+// threads, each with its own solvers. The search runs once over all selected references (the shared origin) and once
+// per trajectory (its depth modes only), the nodes pick the origin of their traj_id.
+struct CandidateResult
+{
+  double origin[3] {0.0, 0.0, 0.0};
+  bool feasible {false};
+  double margin {0.0};
+  double manipulability {0.0};
+  double score {-1.0};
+};
+
+// determinant of a small dense matrix (row-major, n x n), Gaussian elimination with partial pivoting
+double determinant(std::vector<double> a, int n)
+{
+  double det = 1.0;
+  for (int c=0; c<n; c++) {
+    int pivot = c;
+    for (int r=c+1; r<n; r++) if (std::abs(a[r*n + c]) > std::abs(a[pivot*n + c])) pivot = r;
+    if (a[pivot*n + c] == 0.0) return 0.0;
+    if (pivot != c) {
+      for (int k=0; k<n; k++) std::swap(a[c*n + k], a[pivot*n + k]);
+      det = -det;
+    }
+    det *= a[c*n + c];
+    for (int r=c+1; r<n; r++) {
+      double f = a[r*n + c] / a[c*n + c];
+      for (int k=c; k<n; k++) a[r*n + k] -= f * a[c*n + k];
+    }
+  }
+  return det;
+}
+
+
+class OriginOptimizer : public rclcpp::Node
+{
+public:
+
+  // parameters name list
+  std::vector<std::string> param_names = {"excursion", "samples_per_traj", "grid_step", "margin_weight", "arc_length", "threads", "output"};
+  double excursion {0.05};      // expected human excursion around the reference [m]
+  int samples_per_traj {50};
+  double grid_step {0.01};      // [m]
+  double margin_weight {0.5};
+  int arc_length {0};
+  int threads {0};              // 0 = all hardware threads
+  std::string output {origin_config_path};
+  std::vector<long int> traj_ids {0, 1, 2, 3, 4, 5};
+  std::vector<long int> depth_modes {0, 1};
+  std::vector<double> x_range {0.35, 0.65};
+  std::vector<double> z_range {0.25, 0.55};
+
+  KDL::Tree panda_tree;
+  KDL::Chain panda_chain;
+  KDL::Rotation orientation;
+
+  // every path (reference x depth mode) of the current search as offsets from the origin, independent of the candidate
+  std::vector<std::vector<KDL::Vector>> paths;
+
+  static constexpr int num_trajs = TaskOrigins::num_trajs;   // traj_origins must cover all of them
+
+
+  OriginOptimizer()
+  : Node("origin_optimizer")
+  {
+    // parameter stuff
+    this->declare_parameter(param_names.at(0), excursion);
+    this->declare_parameter(param_names.at(1), samples_per_traj);
+    this->declare_parameter(param_names.at(2), grid_step);
+    this->declare_parameter(param_names.at(3), margin_weight);
+    this->declare_parameter(param_names.at(4), arc_length);
+    this->declare_parameter(param_names.at(5), threads);
+    this->declare_parameter(param_names.at(6), output);
+    this->declare_parameter("traj_ids", traj_ids);
+    this->declare_parameter("depth_modes", depth_modes);
+    this->declare_parameter("x_range", x_range);
+    this->declare_parameter("z_range", z_range);
+
+    std::vector<rclcpp::Parameter> params = this->get_parameters(param_names);
+    excursion = std::stod(params.at(0).value_to_string().c_str());
+    samples_per_traj = std::max(2, std::stoi(params.at(1).value_to_string().c_str()));
+    grid_step = std::stod(params.at(2).value_to_string().c_str());
+    margin_weight = std::clamp(std::stod(params.at(3).value_to_string().c_str()), 0.0, 1.0);
+    arc_length = std::stoi(params.at(4).value_to_string().c_str());
+    threads = std::stoi(params.at(5).value_to_string().c_str());
+    output = params.at(6).value_to_string();
+    traj_ids = this->get_parameter("traj_ids").as_integer_array();
+    depth_modes = this->get_parameter("depth_modes").as_integer_array();
+    x_range = this->get_parameter("x_range").as_double_array();
+    z_range = this->get_parameter("z_range").as_double_array();
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    print_params();
+  }
+
+  bool run()
+  {
+    if (!kdl_parser::treeFromFile(urdf_path, panda_tree)) {
+      std::cout << "Failed to construct kdl tree" << std::endl;
+      return false;
+    }
+    panda_tree.getChain("panda_link0", "panda_grasptarget", panda_chain);
+
+    // the controller holds the orientation it starts from, i.e. the home pose
+    KDL::ChainFkSolverPos_recursive fk_solver(panda_chain);
+    KDL::JntArray home(n_joints);
+    for (unsigned int i=0; i<n_joints; i++) home(i) = home_joint_vals.at(i);
+    KDL::Frame home_frame;
+    fk_solver.JntToCart(home, home_frame);
+    orientation = home_frame.M;
+
+    // shared origin over every selected reference
+    build_paths(traj_ids);
+    CandidateResult shared;
+    if (!search(shared)) return false;
+    std::cout << "Best shared origin = {" << shared.origin[0] << ", " << shared.origin[1] << ", " << shared.origin[2] << "}, joint-limit margin = "
+              << shared.margin << ", manipulability = " << shared.manipulability << "\n" << std::endl;
+
+    // for comparison, the origins currently used in the nodes
+    for (const auto & o : std::vector<std::vector<double>> {{0.5059, 0.0, 0.4346}, {0.4569, 0.0, 0.3853}, {0.4559, 0.0, 0.3846}}) {
+      CandidateResult r = evaluate(o.at(0), o.at(2));
+      std::cout << "  origin {" << o.at(0) << ", " << o.at(1) << ", " << o.at(2) << "}: "
+                << (r.feasible ? "margin = " + std::to_string(r.margin) + ", manipulability = " + std::to_string(r.manipulability) : "infeasible")
+                << std::endl;
+    }
+    std::cout << std::endl;
+
+    // one origin per trajectory, the shared one for the trajectories that are not selected
+    std::vector<CandidateResult> per_traj(num_trajs, shared);
+    for (long int traj_id : traj_ids) {
+      if (traj_id < 0 || traj_id >= num_trajs) continue;
+      build_paths({traj_id});
+      if (paths.empty() || !search(per_traj.at(traj_id))) {
+        std::cout << "Trajectory " << traj_id << " keeps the shared origin\n" << std::endl;
+        per_traj.at(traj_id) = shared;
+        continue;
+      }
+      const CandidateResult & r = per_traj.at(traj_id);
+      std::cout << "Trajectory " << traj_id << ": origin = {" << r.origin[0] << ", " << r.origin[1] << ", " << r.origin[2] << "}, joint-limit margin = "
+                << r.margin << ", manipulability = " << r.manipulability << "\n" << std::endl;
+    }
+
+    return write_origin(shared, per_traj);
+  }
+
+private:
+
+  // coarse grid over the search range, then the finer grid around its best candidate
+  bool search(CandidateResult & result)
+  {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<CandidateResult> coarse = evaluate_grid(x_range.at(0), x_range.at(1), z_range.at(0), z_range.at(1), grid_step);
+    const CandidateResult * best = best_of(coarse);
+    if (best == nullptr) {
+      std::cout << "No feasible origin in x = [" << x_range.at(0) << ", " << x_range.at(1) << "], z = ["
+                << z_range.at(0) << ", " << z_range.at(1) << "], try a smaller excursion or a larger range" << std::endl;
+      return false;
+    }
+    double bx = best->origin[0], bz = best->origin[2];
+    std::vector<CandidateResult> fine = evaluate_grid(bx - grid_step, bx + grid_step, bz - grid_step, bz + grid_step, grid_step / 4);
+    fine.insert(fine.end(), coarse.begin(), coarse.end());
+    best = best_of(fine);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Evaluated " << fine.size() << " candidates (" << fine.size() * points_per_candidate() << " IK solves) in "
+              << seconds << " [s] on " << threads << " threads" << std::endl;
+    result = *best;
+    return true;
+  }
+
+  void build_paths(const std::vector<long int> & ids)
+  {
+    paths.clear();
+    for (long int traj_id : ids) {
+      for (long int use_depth : depth_modes) {
+        SineSumParams p;
+        if (!get_sine_sum_params(traj_id, p)) continue;
+        p.use_depth = use_depth;
+        ReferenceTrajectory reference;
+        reference.build([&p](double t, double * xyz) { sine_sum_offset(p, t, xyz); }, control_freq * traj_duration, arc_length == 1);
+
+        std::vector<KDL::Vector> path;
+        for (int k=0; k<samples_per_traj; k++) {
+          const double * o = reference.offset_at((int) std::lround((double) k / (samples_per_traj - 1) * reference.num_ticks()));
+          path.push_back(KDL::Vector(o[0], o[1], o[2]));
+        }
+        paths.push_back(path);
+      }
+    }
+  }
+
+  long points_per_candidate() const { return (long) paths.size() * samples_per_traj * 7; }
+
+  std::vector<CandidateResult> evaluate_grid(double x0, double x1, double z0, double z1, double step)
+  {
+    std::vector<CandidateResult> results;
+    for (double x=x0; x<=x1+1e-9; x+=step) {
+      for (double z=z0; z<=z1+1e-9; z+=step) {
+        CandidateResult r;
+        r.origin[0] = x;
+        r.origin[2] = z;
+        results.push_back(r);
+      }
+    }
+
+    // candidates are handed out one at a time, so threads that hit infeasible (early-out) ones keep busy
+    std::atomic<size_t> next {0};
+    std::vector<std::thread> workers;
+    for (int t=0; t<threads; t++) {
+      workers.emplace_back([this, &results, &next]() {
+        for (size_t i=next++; i<results.size(); i=next++) results[i] = evaluate(results[i].origin[0], results[i].origin[2]);
+      });
+    }
+    for (auto & w : workers) w.join();
+    return results;
+  }
+
+  // any thread: own solvers, the chain and the paths are only read
+  CandidateResult evaluate(double x, double z) const
+  {
+    KDL::ChainFkSolverPos_recursive fk_solver(panda_chain);
+    KDL::ChainIkSolverVel_pinv vel_ik_solver(panda_chain, 0.0001, 1000);
+    KDL::ChainIkSolverPos_NR ik_solver(panda_chain, fk_solver, vel_ik_solver, 1000);
+    KDL::ChainJntToJacSolver jac_solver(panda_chain);
+    KDL::JntArray q_path(n_joints), q(n_joints);
+    KDL::Jacobian jac(n_joints);
+    KDL::Frame frame;
+    std::vector<double> jjt(36);
+
+    CandidateResult r;
+    r.origin[0] = x;
+    r.origin[2] = z;
+    r.margin = std::numeric_limits<double>::max();
+    r.manipulability = std::numeric_limits<double>::max();
+    const KDL::Vector origin(x, 0.0, z);
+    const KDL::Vector excursions[7] {KDL::Vector(0, 0, 0),
+                                     KDL::Vector(excursion, 0, 0), KDL::Vector(-excursion, 0, 0),
+                                     KDL::Vector(0, excursion, 0), KDL::Vector(0, -excursion, 0),
+                                     KDL::Vector(0, 0, excursion), KDL::Vector(0, 0, -excursion)};
+
+    for (const auto & path : paths) {
+      for (unsigned int i=0; i<n_joints; i++) q_path(i) = home_joint_vals.at(i);
+      for (const KDL::Vector & offset : path) {
+        for (int e=0; e<7; e++) {
+          // the reference point itself (e = 0) carries the warm start along the path, excursions start from it
+          KDL::Frame goal(orientation, origin + offset + excursions[e]);
+          if (ik_solver.CartToJnt(q_path, goal, q) < 0) return r;
+          fk_solver.JntToCart(q, frame);
+          if ((frame.p - goal.p).Norm() > 1e-3) return r;
+
+          for (unsigned int i=0; i<n_joints; i++) {
+            if (q(i) < lower_joint_limits.at(i) || q(i) > upper_joint_limits.at(i)) return r;
+            double range = upper_joint_limits.at(i) - lower_joint_limits.at(i);
+            r.margin = std::min(r.margin, std::min(q(i) - lower_joint_limits.at(i), upper_joint_limits.at(i) - q(i)) / range);
+          }
+
+          jac_solver.JntToJac(q, jac);
+          for (int a=0; a<6; a++) {
+            for (int b=0; b<6; b++) {
+              double sum = 0.0;
+              for (unsigned int k=0; k<n_joints; k++) sum += jac(a, k) * jac(b, k);
+              jjt[a*6 + b] = sum;
+            }
+          }
+          r.manipulability = std::min(r.manipulability, std::sqrt(std::max(determinant(jjt, 6), 0.0)));
+
+          if (e == 0) q_path = q;
+        }
+      }
+    }
+    r.feasible = true;
+    return r;
+  }
+
+  // scores relative to the best margin / manipulability among the feasible candidates
+  const CandidateResult * best_of(std::vector<CandidateResult> & results) const
+  {
+    double max_margin = 0.0, max_manip = 0.0;
+    for (const auto & r : results) {
+      if (!r.feasible) continue;
+      max_margin = std::max(max_margin, r.margin);
+      max_manip = std::max(max_manip, r.manipulability);
+    }
+    const CandidateResult * best = nullptr;
+    for (auto & r : results) {
+      if (!r.feasible) continue;
+      r.score = margin_weight * r.margin / std::max(max_margin, 1e-12) + (1.0 - margin_weight) * r.manipulability / std::max(max_manip, 1e-12);
+      if (best == nullptr || r.score > best->score) best = &r;
+    }
+    return best;
+  }
+
+  // ROS 2 parameter file for every node, pass it with --params-file (see NOTES.txt)
+  // origin is the shared one, traj_origins holds x, y, z per traj_id (the nodes use it when it is complete)
+  bool write_origin(const CandidateResult & best, const std::vector<CandidateResult> & per_traj) const
+  {
+    std::ofstream file(output);
+    if (!file.is_open()) {
+      std::cout << "Could not write " << output << std::endl;
+      return false;
+    }
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+    file.precision(5);
+    file << std::fixed;
+    file << "# task-space origin of real_controller, gazebo_controller and marker_publisher: origin is shared by all\n";
+    file << "# references, traj_origins has one x, y, z per traj_id (real_controller and marker_publisher select theirs)\n";
+    file << "# written by origin_optimizer on " << stamp << ": excursion = " << excursion << " [m], shared joint-limit margin = "
+         << best.margin << ", manipulability = " << best.manipulability << "\n";
+    file << "/**:\n";
+    file << "  ros__parameters:\n";
+    file << "    origin: [" << best.origin[0] << ", " << best.origin[1] << ", " << best.origin[2] << "]\n";
+    file << "    traj_origins: [";
+    for (size_t k=0; k<per_traj.size(); k++) {
+      const CandidateResult & r = per_traj.at(k);
+      file << (k == 0 ? "" : ",\n                   ") << r.origin[0] << ", " << r.origin[1] << ", " << r.origin[2];
+    }
+    file << "]\n";
+    std::cout << "Origin written to " << output << "\n" << std::endl;
+    return file.good();
+  }
+
+  void print_params() {
+    for (unsigned int i=0; i<10; i++) std::cout << "\n";
+    std::cout << "\n\nThe current parameters [origin_optimizer] are as follows:\n" << std::endl;
+    std::cout << "Trajectory IDs = " << traj_ids.size() << ", depth modes = " << depth_modes.size() << ", arc length = " << arc_length << "\n" << std::endl;
+    std::cout << "Human excursion = " << excursion << " [m], samples per trajectory = " << samples_per_traj << "\n" << std::endl;
+    std::cout << "Search x = [" << x_range.at(0) << ", " << x_range.at(1) << "], z = [" << z_range.at(0) << ", " << z_range.at(1)
+              << "], grid step = " << grid_step << " [m]\n" << std::endl;
+    std::cout << "Margin weight = " << margin_weight << ", threads = " << threads << "\n" << std::endl;
+    std::cout << "Output = " << output << "\n" << std::endl;
+    for (unsigned int i=0; i<10; i++) std::cout << "\n";
+  }
+};
+
+
+//////////////////// MAIN FUNCTION ///////////////////
+
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  bool ok = std::make_shared<OriginOptimizer>()->run();
+  rclcpp::shutdown();
+  return ok ? 0 : 1;
+}
@@ -2,12 +2,20 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <algorithm>
 
 #include "rclcpp/rclcpp.hpp"
 #include "std_msgs/msg/string.hpp"
+#include "std_msgs/msg/float64.hpp"
+#include "std_msgs/msg/bool.hpp"
 
 #include "tutorial_interfaces/msg/falconpos.hpp"
 
+#include "cpp_pubsub/input_filters.hpp"
+#include "cpp_pubsub/hri_trace.hpp"
+#include "cpp_pubsub/rt_setup.hpp"
+#include "cpp_pubsub/falcon_correction.hpp"
+
 #include <stdio.h>
 #include "dhdc.h"
 
@@ -22,13 +30,29 @@ class PositionTalker : public rclcpp::Node
 public:
 
   // parameters name list
-  std::vector<std::string> param_names = {"mapping_ratio", "use_depth", "part_id", "alpha_id", "traj_id"};
+  std::vector<std::string> param_names = {"mapping_ratio", "use_depth", "part_id", "alpha_id", "traj_id",
+                                          "filter_type", "filter_min_cutoff", "filter_beta", "filter_d_cutoff",
+                                          "filter_natural_freq", "filter_process_noise", "filter_measurement_noise",
+                                          "rt_cpus", "rt_priority", "rt_lock_memory", "correction_file"};
   double mapping_ratio {3.0};
   int use_depth {0};
   int part_id {0};
   int alpha_id {0};
   int traj_id {0};
 
+  // filter stage applied to the published position {0, 1, 2, 3} = {none, One-Euro, 2nd-order, Kalman}
+  FilterSettings filter_settings;
+  AxisFilter filters[3];
+  double filtered_p[3] {0.0, 0.0, 0.0};
+  double last_sample_time {-1.0};
+
+  // real-time placement, normally set by the launch profile (see config/placement_profiles.yaml)
+  RtSettings rt_settings;
+
+  // position correction lookup table from falcon_calibration, applied to every position read ("" = off)
+  std::string correction_file;
+  FalconCorrection correction;
+
   // other arrays
   double p[3] {0.0, 0.0, 0.0};
   double v[3] {0.0, 0.0, 0.0};
@@ -64,6 +88,17 @@ public:
     this->declare_parameter(param_names.at(2), 0);
     this->declare_parameter(param_names.at(3), 0);
     this->declare_parameter(param_names.at(4), 0);
+    this->declare_parameter(param_names.at(5), 0);
+    this->declare_parameter(param_names.at(6), filter_settings.min_cutoff);
+    this->declare_parameter(param_names.at(7), filter_settings.beta);
+    this->declare_parameter(param_names.at(8), filter_settings.d_cutoff);
+    this->declare_parameter(param_names.at(9), filter_settings.natural_freq);
+    this->declare_parameter(param_names.at(10), filter_settings.process_noise);
+    this->declare_parameter(param_names.at(11), filter_settings.measurement_noise);
+    this->declare_parameter(param_names.at(12), std::string(""));
+    this->declare_parameter(param_names.at(13), 0);
+    this->declare_parameter(param_names.at(14), 0);
+    this->declare_parameter(param_names.at(15), std::string(""));
     
     std::vector<rclcpp::Parameter> params = this->get_parameters(param_names);
     mapping_ratio = std::stod(params.at(0).value_to_string().c_str());
@@ -71,8 +106,24 @@ public:
     part_id = std::stoi(params.at(2).value_to_string().c_str());
     alpha_id = std::stoi(params.at(3).value_to_string().c_str());
     traj_id = std::stoi(params.at(4).value_to_string().c_str());
+    filter_settings.type = static_cast<FilterType>(std::stoi(params.at(5).value_to_string().c_str()));
+    filter_settings.min_cutoff = std::stod(params.at(6).value_to_string().c_str());
+    filter_settings.beta = std::stod(params.at(7).value_to_string().c_str());
+    filter_settings.d_cutoff = std::stod(params.at(8).value_to_string().c_str());
+    filter_settings.natural_freq = std::stod(params.at(9).value_to_string().c_str());
+    filter_settings.process_noise = std::stod(params.at(10).value_to_string().c_str());
+    filter_settings.measurement_noise = std::stod(params.at(11).value_to_string().c_str());
+    rt_settings.cpus = parse_cpu_list(params.at(12).value_to_string());
+    rt_settings.priority = std::stoi(params.at(13).value_to_string().c_str());
+    rt_settings.lock_memory = std::stoi(params.at(14).value_to_string().c_str()) != 0;
+    correction_file = params.at(15).value_to_string();
     print_params();
 
+    if (!correction_file.empty()) {
+      if (correction.load(correction_file)) std::cout << "Falcon correction table loaded from " << correction_file << "\n" << std::endl;
+      else std::cout << "Could not load the Falcon correction table " << correction_file << ", positions are NOT corrected\n" << std::endl;
+    }
+
     // update first point if not using depth
     if (use_depth == 0) first_point = {0.01, -0.16, -0.01};
 
@@ -82,6 +133,17 @@ public:
     // publisher
     publisher_ = this->create_publisher<tutorial_interfaces::msg::Falconpos>("falcon_position", 10);
     timer_ = this->create_wall_timer(2ms, std::bind(&PositionTalker::timer_callback, this));       ///////// publishing at 500 Hz /////////
+
+    // filter group delay diagnostics, published once per second
+    filter_delay_pub_ = this->create_publisher<std_msgs::msg::Float64>("falcon_filter_delay", 10);
+
+    // button state, used by the controller for clutching
+    button_pub_ = this->create_publisher<std_msgs::msg::Bool>("falcon_button", 10);
+
+    // switch this (executor) thread to real-time and report what was granted
+    std::string rt_report;
+    bool rt_granted = apply_rt_settings(rt_settings, rt_report);
+    std::cout << "Real-time placement [position_talker]" << (rt_granted ? "" : " - NOT FULLY GRANTED") << ":\n" << rt_report << std::endl;
   }
 
 
@@ -91,6 +153,7 @@ private:
   { 
     ///////////////////////// FALCON STUFF /////////////////////////
     dhdGetPosition(&(p[0]), &(p[1]), &(p[2]));
+    HRI_TRACE(falcon_read, count);
     dhdGetLinearVelocity (&(v[0]), &(v[1]), &(v[2]));
 
     if (count < count_thres2) {
@@ -111,14 +174,35 @@ private:
       rclcpp::shutdown();
     }
 
+    // correct the linkage distortion on a copy (one cell lookup, no-op without a table) and filter it per axis;
+    // the centering forces above use the raw position, so a bad table never moves the spring's rest point
+    double corrected_p[3] {p[0], p[1], p[2]};
+    correction.correct(corrected_p);
+    double now = dhdGetTime();
+    double dt = 1.0 / pub_freq;
+    if (last_sample_time > 0.0) dt = std::clamp(now - last_sample_time, 0.1 / pub_freq, 10.0 / pub_freq);
+    last_sample_time = now;
+    for (int i=0; i<3; i++) filtered_p[i] = filters[i].filter(corrected_p[i], dt, filter_settings);
+
+    if (count % pub_freq == 0) {
+      auto delay_msg = std_msgs::msg::Float64();
+      delay_msg.data = 0.0;
+      for (int i=0; i<3; i++) delay_msg.data = std::max(delay_msg.data, filters[i].group_delay(filter_settings));   // in [s]
+      filter_delay_pub_->publish(delay_msg);
+    }
+
     // generate and publish the message
     auto message = tutorial_interfaces::msg::Falconpos();
-    message.x = p[0] * 100;
-    message.y = p[1] * 100;
-    message.z = p[2] * 100;
+    message.x = filtered_p[0] * 100;
+    message.y = filtered_p[1] * 100;
+    message.z = filtered_p[2] * 100;
     // RCLCPP_INFO(this->get_logger(), "Publishing position: px = %.3f, py = %.3f, pz = %.3f  [in cm]", message.x, message.y, message.z);
     publisher_->publish(message);
+    HRI_TRACE(falcon_publish, count, message.x, message.y, message.z);
 
+    auto button_msg = std_msgs::msg::Bool();
+    button_msg.data = (dhdGetButton(0) == DHD_ON);
+    button_pub_->publish(button_msg);
 
 
     if (dhdKbHit() && dhdKbGet() == 'q') {
@@ -165,11 +249,15 @@ private:
     std::cout << "Participant ID = " << part_id << "\n" << std::endl;
     std::cout << "Alpha ID = " << alpha_id << "\n" << std::endl;
     std::cout << "Trajectory ID = " << traj_id << "\n" << std::endl;
+    std::cout << "Filter type = " << static_cast<int>(filter_settings.type) << "\n" << std::endl;
+    std::cout << "Correction file = " << (correction_file.empty() ? "none" : correction_file) << "\n" << std::endl;
     for (unsigned int i=0; i<10; i++) std::cout << "\n";
   }
 
   rclcpp::TimerBase::SharedPtr timer_;
   rclcpp::Publisher<tutorial_interfaces::msg::Falconpos>::SharedPtr publisher_;
+  rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr filter_delay_pub_;
+  rclcpp::Publisher<std_msgs::msg::Bool>::SharedPtr button_pub_;
 
   const int count_thres1 = 1 * pub_freq;   // 1 second
   const int count_thres2 = 1.5 * pub_freq;   // 1.5 seconds
@@ -2,6 +2,7 @@
 #include "std_msgs/msg/string.hpp"
 #include "std_msgs/msg/float64.hpp"
 #include "std_msgs/msg/bool.hpp"
+#include "std_msgs/msg/float64_multi_array.hpp"
 #include "trajectory_msgs/msg/joint_trajectory.hpp"
 #include "trajectory_msgs/msg/joint_trajectory_point.hpp"
 #include "sensor_msgs/msg/joint_state.hpp"
@@ -9,7 +10,29 @@
 #include "tutorial_interfaces/msg/falconpos.hpp"
 #include "tutorial_interfaces/msg/pos_info.hpp"
 
+#include "cpp_pubsub/transitions.hpp"
+#include "cpp_pubsub/reference_trajectory.hpp"
+#include "cpp_pubsub/workspace_indexing.hpp"
+#include "cpp_pubsub/motion_scaling.hpp"
+#include "cpp_pubsub/shared_mpc.hpp"
+#include "cpp_pubsub/participant_store.hpp"
+#include "cpp_pubsub/alpha_adaptation.hpp"
+#include "cpp_pubsub/tick_scheduler.hpp"
+#include "cpp_pubsub/hri_trace.hpp"
+#include "cpp_pubsub/phase_trace.hpp"
+#include "cpp_pubsub/rt_setup.hpp"
+#include "cpp_pubsub/live_config.hpp"
+#include "cpp_pubsub/perturbation.hpp"
+#include "cpp_pubsub/upsampling.hpp"
+#include "cpp_pubsub/tracking_score.hpp"
+#include "cpp_pubsub/trial_log.hpp"
+#include "cpp_pubsub/free_drive_calibration.hpp"
+#include "cpp_pubsub/session_checkpoint.hpp"
+#include "cpp_pubsub/task_origin.hpp"
+
 #include <chrono>
+#include <ctime>
+#include <filesystem>
 #include <functional>
 #include <memory>
 #include <string>
@@ -26,10 +49,12 @@
 #include <kdl/jntarray.hpp>
 
 #include <algorithm>
+#include <atomic>
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
 
 
 using namespace std::chrono_literals;
@@ -37,10 +62,14 @@ using namespace std::chrono_literals;
 
 /////////////////// global variables ///////////////////
 const std::string urdf_path = "/home/michael/HRI/ros2_ws/src/cpp_pubsub/urdf/panda.urdf";
+const std::string participant_dir = "/home/michael/HRI/ros2_ws/src/cpp_pubsub/participant_data/";
+const std::string phase_trace_dir = "/home/michael/HRI/ros2_ws/src/cpp_pubsub/data_logging/phase_traces/";
+const std::string trial_log_dir = "/home/michael/HRI/ros2_ws/src/cpp_pubsub/data_logging/trial_logs/";
 const unsigned int n_joints = 7;
 
 const std::vector<double> lower_joint_limits {-2.8973, -1.7628, -2.8973, -3.0718, -2.8973, -0.0175, -2.8973};
 const std::vector<double> upper_joint_limits {2.8973, 1.7628, 2.8973, -0.0698, 2.8973, 3.7525, 2.8973};
+const std::vector<double> max_joint_velocities {2.1750, 2.1750, 2.1750, 2.1750, 2.6100, 2.6100, 2.6100};   // [rad/s]
 
 const bool display_time = false;
 
@@ -67,10 +96,6 @@ std::vector< std::vector<double> > alphas_dict {
 void compute_ik(std::vector<double>& desired_tcp_pos, std::vector<double>& curr_vals, std::vector<double>& res_vals);
 
 void readCSV(const std::string& filename, std::vector<double>& dataArray);
-double linearInterpolate(double y1, double y2, double mu);
-double cosineInterpolate(double y1, double y2, double mu);
-std::vector<double> linear_interpolate_vec(std::vector<double> old_vec, int num_interp);
-std::vector<double> cosine_interpolate_vec(std::vector<double> old_vec, int num_interp);
 
 bool within_limits(std::vector<double>& vals);
 bool create_tree();
@@ -80,6 +105,35 @@ double get_min(double a, double b);
 void print_joint_vals(std::vector<double>& joint_vals);
 
 
+/////////////////// live-updatable trial settings ///////////////////
+// the parameters that can be changed while the node runs
+struct LiveParams
+{
+  int free_drive {0};
+  double mapping_ratio {3.0};
+  int use_depth {0};
+  int alpha_id {0};
+  int traj_id {0};
+  MappingSettings mapping;
+  int noise_mode {0};                  // startup only: {0, 1} = {noise csv file on z, spectral perturbation}
+  int noise_kernel {0};                // startup only: upsampling of the noise csv files, see KernelType
+  PerturbationSettings perturbation;   // startup only
+};
+
+// everything derived from LiveParams, built off the control thread (see LiveConfig)
+struct TrialConfig
+{
+  LiveParams params;
+  double alpha[3] {0.0, 0.0, 0.0};
+  SineSumParams traj_params;
+  ReferenceTrajectory reference;
+  std::string nid;
+  PerturbationTable perturbation;   // per-tick robot target (x, y, z) and joint perturbations
+  MotionScaling scaling;   // only touched by the control thread once published
+  double origin[3] {0.0, 0.0, 0.0};   // task-space origin of traj_id
+};
+
+
 /////////////// DEFINITION OF NODE CLASS //////////////
 
 class RealController : public rclcpp::Node
@@ -87,20 +141,110 @@ class RealController : public rclcpp::Node
 public:
 
   // parameters name list
-  std::vector<std::string> param_names = {"free_drive", "mapping_ratio", "use_depth", "part_id", "alpha_id", "traj_id"};
+  std::vector<std::string> param_names = {"free_drive", "mapping_ratio", "use_depth", "part_id", "alpha_id", "traj_id", "blend_type", "arc_length",
+                                          "clutch", "rate_zone", "rate_gain",
+                                          "mapping_mode", "prism_min_speed", "prism_max_speed", "prism_min_scale", "lut_exponent",
+                                          "control_mode", "mpc_smoothing", "mpc_max_speed",
+                                          "adapt_alpha", "adapt_target_error", "adapt_gain",
+                                          "loop_mode", "tick_policy", "tick_max_burst",
+                                          "trace_window", "rt_cpus", "rt_priority", "rt_lock_memory",
+                                          "noise_mode", "noise_f_low", "noise_f_high", "noise_correlation", "noise_envelope", "noise_seed",
+                                          "noise_kernel", "score_half_error", "trial_log", "use_calibration", "session"};
   int free_drive {0};
   double mapping_ratio {3.0};
   int use_depth {0};
   int part_id {0};
   int alpha_id {0};
   int traj_id {0};
+  int blend_type {2};   // {0, 1, 2} = {linear, cubic, quintic / minimum-jerk} phase transitions
+  int arc_length {0};   // 1 = move the reference at constant speed along the curve
+  IndexingSettings indexing_settings;   // clutch (Falcon button) & rate-control zone at the device workspace edge
+  MappingSettings mapping_settings;     // {0, 1, 2, 3} = {uniform mapping_ratio, per-axis gains, PRISM, lookup table}
+  int control_mode {0};                 // {0, 1} = {convex blend, model-predictive shared control}
+  int adapt_alpha {0};                  // {0, 1, 2} = {fixed alphas, adapt between trials, adapt online every second}
+  AdaptationSettings adapt_settings;
+  AlphaAdaptation adaptation;
+  ScoreSettings score_settings;         // running tracking error of the TCP vs. the reference, shown by the marker publisher
+  TrackingScore tracking_score;
+  std_msgs::msg::Float64MultiArray score_msg;
+  const int score_pub_frequency = 10;   // in [Hz]
+  int write_trial_log {1};              // one binary record per control tick (see trial_log.hpp), replayed by trial_replay
+  TrialLogWriter trial_log;
+
+  // free-drive calibration: a free-drive trial measures the participant's comfortable device range / speed and stores
+  // per-axis mapping gains and centering (participant_dir), later trials of that participant start from them
+  int use_calibration {1};
+  CalibrationSettings calibration_settings;
+  FreeDriveCalibration calibration;
+  double calibration_extent[3] {0.0, 0.0, 0.0};   // reference half extent over all trajectories [m]
+  double calibration_speed[3] {0.0, 0.0, 0.0};    // peak reference speed over all trajectories [m/s]
+
+  // session checkpoint (see session_checkpoint.hpp): the conditions a participant completed survive an aborted run,
+  // with a session_plan the next start picks the first condition that is not done yet
+  int use_session {1};
+  std::unique_ptr<SessionCheckpoint> session;
+  SessionSaver session_saver;                  // the end-of-recording checkpoint is written off the control thread
+  std::atomic<int64_t> last_falcon_ns {-1};    // last Falcon sample, since control_epoch
+  int64_t last_falcon_stamp_ns = 0;            // publication time of the last Falcon sample (0 = not set by the middleware)
+  bool falcon_lost = false;
+  const int64_t falcon_timeout_ns = 250000000;   // no Falcon sample for this long while recording = attempt not done
+  bool session_plan_active = false;             // alpha_id / traj_id / free_drive cannot change live then
+  bool session_condition_changed = false;      // changed live after the recording started, the attempt is not done
+  int32_t last_log_phase = -1;
+  int loop_mode {0};                    // {0, 1, 2} = {wall timers + rclcpp::spin, explicit wait-set loop, joint-state triggered}
+
+  // joint-state triggered ticks (loop_mode 2): a new joint-state sample triggers the tick if at least 90% of a period
+  // has passed since the last one. Without samples the 2 ms timer runs the ticks on the deadline grid
+  // last_tick_time + k * period; the half-period slack only applies while a joint state is still expected
+  std::chrono::steady_clock::time_point last_tick_time;
+  bool joint_states_expected = true;
+  long joint_state_count = 0;
+  long triggered_ticks = 0;
+  long fallback_ticks = 0;
+  long triggered_overruns = 0;   // fallback ticks beyond the timer granularity, i.e. deadlines the fallback timer missed
+
+  // absolute-time tick scheduling for the timer and wait-set loops, {0, 1, 2} = {catch up, skip, compress} missed ticks
+  int tick_policy {0};
+  int tick_max_burst {5};
+  TickScheduler scheduler;
+  bool scheduler_started = false;
+  const std::chrono::steady_clock::time_point control_epoch = std::chrono::steady_clock::now();
+  std_msgs::msg::Float64MultiArray timing_msg;   // controller_timing, sized once in the constructor
+
+  // per-tick phase timings of the last trace_window seconds, dumped as a Chrome trace on a deadline miss
+  double trace_window {2.0};   // in [s], 0 disables the phase trace
+  PhaseTraceRing phase_trace;
+  std::chrono::steady_clock::time_point phase_start;
+  std::vector<std::pair<int64_t, std::string>> trace_markers;
+  int64_t last_trace_dump_ns = -1;
+  PhaseTraceWriter trace_writer;
+  static constexpr int trace_spans_per_tick = num_tick_phases + 1;   // logging is closed twice per tick
+
+  // real-time placement, normally set by the launch profile (see config/placement_profiles.yaml)
+  RtSettings rt_settings;
+
+  // measured TCP from every joint-state sample (preallocated forward kinematics), published in batches of
+  // measured_batch_size rows {joint-state stamp [s], receive time [s], measured x, y, z [m], commanded x, y, z [m]}
+  static constexpr int measured_batch_size = 10;
+  static constexpr int measured_fields = 8;
+  std::unique_ptr<KDL::ChainFkSolverPos_recursive> fk_solver;
+  KDL::JntArray fk_joints = KDL::JntArray(n_joints);
+  KDL::Frame fk_frame;
+  std_msgs::msg::Float64MultiArray measured_msg;
+  int measured_in_batch = 0;
   
-  std::vector<double> origin {0.5059, 0.0, 0.4346}; //////// can change the task-space origin point! ////////
+  std::vector<double> origin {0.5059, 0.0, 0.4346}; //////// can change the task-space origin point! (parameter "origin", see config/origin.yaml) ////////
+  TaskOrigins task_origins;   // origin of every traj_id (parameter "traj_origins"), see task_origin.hpp
+  std::atomic<bool> origin_held {false};   // the robot moves towards the origin, a traj_id with another origin is rejected
 
   std::vector<double> human_offset {0.0, 0.0, 0.0};
   std::vector<double> ref_offset {0.0, 0.0, 0.0};
   std::vector<double> robot_offset {0.0, 0.0, 0.0};
 
+  // Falcon position mapped into the robot frame, before clutching / workspace indexing
+  double mapped_falcon[3] {0.0, 0.0, 0.0};
+  WorkspaceIndexing indexing;
+
   std::vector<double> curr_joint_vals {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
   std::vector<double> ik_joint_vals {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
   std::vector<double> message_joint_vals {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
@@ -144,16 +288,22 @@ public:
   // for robot trajectory following
   double t_param = 0.0;
 
-  // sine curve parameters (initialization)
-  int pa = 0;
-  int pb = 0;
-  int pc = 0;
-  double ps = 0.0;
-  double ph = 0.0;
-
-  double depth = 0.1;
-  double width = 0.3;
-  double height = 0.1;
+  // active trial configuration (alphas, reference table, noise, mapping), swapped in at the start of a tick;
+  // during control the previous one is cross-faded out over config_fade so a change never steps the robot
+  LiveParams live_params;
+  LiveConfig<LiveParams, TrialConfig> live_config;
+  TrialConfig * cfg = nullptr;
+  TrialConfig * prev_cfg = nullptr;
+  BlendProfile config_fade;
+  int config_fade_count = 0;
+  double fade_alpha_from[3] {0.0, 0.0, 0.0};
+
+  // online alpha adaptation: every new alpha is ramped in over config_fade too, a one-tick step of up to max_step
+  // would jump the TCP target by several mm
+  int alpha_ramp_count = -1;   // ticks into the ramp, -1 = no ramp
+  double alpha_ramp_from[3] {0.0, 0.0, 0.0};
+  double shift_from[3] {0.0, 0.0, 0.0};   // alphas at the end of the recording, faded out by the shifting phase
+  const double config_fade_time = 0.5;   // in [s]
 
   // for gradually shifting control to robot after 10 second trajectory
   const int shifting_time = 3;   // seconds
@@ -173,9 +323,24 @@ public:
   const int shutdown_time = 1;    // second
   int max_shutdown_count = shutdown_time * control_freq;
 
-  // empty noise file index string & noise vector
-  std::string nid {};
-  std::vector<double> robot_noise_vector;
+  // model-predictive shared control (see shared_mpc.hpp), horizon of 50 ticks = 100 ms
+  static constexpr int mpc_horizon = 50;
+  MpcSettings mpc_settings;
+  AxisQP<mpc_horizon> mpc_qp[3];
+  double mpc_ref[mpc_horizon];
+  bool mpc_initialized = false;
+  // joint limits as per-axis bounds (joint_limit_bounds): dq/dx columns from the velocity IK, allocated once
+  std::unique_ptr<KDL::ChainIkSolverVel_pinv> mpc_vel_solver;
+  KDL::JntArray mpc_q = KDL::JntArray(n_joints);
+  KDL::JntArray mpc_qdot = KDL::JntArray(n_joints);
+  double mpc_dq_dx[3][n_joints];
+  SolveStats mpc_stats;
+
+  // precomputed blend tables for the smoothing, shifting and homing phases (indexed by ticks into the phase)
+  BlendProfile smoothing_blend;
+  BlendProfile shifting_blend;
+  BlendProfile homing_blend;
+
 
 
   ////////////////////////////////////////////////////////////////////////
@@ -189,6 +354,47 @@ public:
     this->declare_parameter(param_names.at(3), 0);
     this->declare_parameter(param_names.at(4), 0);
     this->declare_parameter(param_names.at(5), 0);
+    this->declare_parameter(param_names.at(6), 2);
+    this->declare_parameter(param_names.at(7), 0);
+    this->declare_parameter(param_names.at(8), 0);
+    this->declare_parameter(param_names.at(9), 0.0);
+    this->declare_parameter(param_names.at(10), 0.0);
+    this->declare_parameter(param_names.at(11), 0);
+    this->declare_parameter(param_names.at(12), mapping_settings.prism_min_speed);
+    this->declare_parameter(param_names.at(13), mapping_settings.prism_max_speed);
+    this->declare_parameter(param_names.at(14), mapping_settings.prism_min_scale);
+    this->declare_parameter(param_names.at(15), mapping_settings.lut_exponent);
+    this->declare_parameter("axis_gains", std::vector<double> {});   // empty = mapping_ratio on every axis
+    this->declare_parameter("origin", origin);
+    this->declare_parameter("traj_origins", std::vector<double> {});
+    this->declare_parameter(param_names.at(16), 0);
+    this->declare_parameter(param_names.at(17), mpc_settings.smoothing);
+    this->declare_parameter(param_names.at(18), mpc_settings.max_step * control_freq);
+    this->declare_parameter(param_names.at(19), 0);
+    this->declare_parameter(param_names.at(20), adapt_settings.target_error);
+    this->declare_parameter(param_names.at(21), adapt_settings.gain);
+    this->declare_parameter(param_names.at(22), 0);
+    this->declare_parameter(param_names.at(23), 0);
+    this->declare_parameter(param_names.at(24), 5);
+    this->declare_parameter(param_names.at(25), 2.0);
+    this->declare_parameter(param_names.at(26), std::string(""));
+    this->declare_parameter(param_names.at(27), 0);
+    this->declare_parameter(param_names.at(28), 0);
+    this->declare_parameter(param_names.at(29), 0);
+    this->declare_parameter(param_names.at(30), live_params.perturbation.f_low);
+    this->declare_parameter(param_names.at(31), live_params.perturbation.f_high);
+    this->declare_parameter(param_names.at(32), live_params.perturbation.correlation);
+    this->declare_parameter(param_names.at(33), 1);
+    this->declare_parameter(param_names.at(34), 0);
+    this->declare_parameter(param_names.at(35), 0);
+    this->declare_parameter(param_names.at(36), score_settings.half_score_error);
+    this->declare_parameter(param_names.at(37), 1);
+    this->declare_parameter(param_names.at(38), 1);
+    this->declare_parameter(param_names.at(39), 1);
+    this->declare_parameter("session_plan", std::vector<int64_t> {});
+    this->declare_parameter("noise_axes_amplitude", std::vector<double> {0.0, 0.0, 0.0});
+    this->declare_parameter("noise_joints_amplitude", std::vector<double> {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0});
+    this->declare_parameter("noise_exponents", std::vector<double> (num_perturbation_channels, 0.0));
     
     std::vector<rclcpp::Parameter> params = this->get_parameters(param_names);
     free_drive = std::stoi(params.at(0).value_to_string().c_str());
@@ -197,35 +403,135 @@ public:
     part_id = std::stoi(params.at(3).value_to_string().c_str());
     alpha_id = std::stoi(params.at(4).value_to_string().c_str());
     traj_id = std::stoi(params.at(5).value_to_string().c_str());
+    blend_type = std::stoi(params.at(6).value_to_string().c_str());
+    arc_length = std::stoi(params.at(7).value_to_string().c_str());
+    indexing_settings.clutch = std::stoi(params.at(8).value_to_string().c_str()) == 1;
+    indexing_settings.rate_zone = std::stod(params.at(9).value_to_string().c_str());
+    indexing_settings.rate_gain = std::stod(params.at(10).value_to_string().c_str());
+    mapping_settings.mode = static_cast<MappingMode>(std::stoi(params.at(11).value_to_string().c_str()));
+    mapping_settings.mapping_ratio = mapping_ratio;
+    mapping_settings.prism_min_speed = std::stod(params.at(12).value_to_string().c_str());
+    mapping_settings.prism_max_speed = std::stod(params.at(13).value_to_string().c_str());
+    mapping_settings.prism_min_scale = std::stod(params.at(14).value_to_string().c_str());
+    mapping_settings.lut_exponent = std::stod(params.at(15).value_to_string().c_str());
+    std::vector<double> origin_param = this->get_parameter("origin").as_double_array();
+    if (origin_param.size() == 3) origin = origin_param;
+    if (!task_origins.configure(origin, this->get_parameter("traj_origins").as_double_array())) {
+      std::cout << "WARNING: traj_origins does not have an origin for all " << TaskOrigins::num_trajs << " trajectories, "
+                << "it is ignored and every trajectory uses the shared origin\n" << std::endl;
+    }
+    task_origins.get(traj_id, origin.data());
+    std::vector<double> axis_gains = this->get_parameter("axis_gains").as_double_array();
+    mapping_settings.axis_gains_set = axis_gains.size() == 3;
+    for (int i=0; i<3; i++) mapping_settings.axis_gains[i] = mapping_settings.axis_gains_set ? axis_gains.at(i) : mapping_ratio;
+    control_mode = std::stoi(params.at(16).value_to_string().c_str());
+    mpc_settings.smoothing = std::stod(params.at(17).value_to_string().c_str());
+    mpc_settings.max_step = std::stod(params.at(18).value_to_string().c_str()) / control_freq;
+    adapt_alpha = std::stoi(params.at(19).value_to_string().c_str());
+    adapt_settings.target_error = std::stod(params.at(20).value_to_string().c_str());
+    adapt_settings.gain = std::stod(params.at(21).value_to_string().c_str());
+    loop_mode = std::stoi(params.at(22).value_to_string().c_str());
+    tick_policy = std::stoi(params.at(23).value_to_string().c_str());
+    tick_max_burst = std::stoi(params.at(24).value_to_string().c_str());
+    trace_window = std::stod(params.at(25).value_to_string().c_str());
+    rt_settings.cpus = parse_cpu_list(params.at(26).value_to_string());
+    rt_settings.priority = std::stoi(params.at(27).value_to_string().c_str());
+    rt_settings.lock_memory = std::stoi(params.at(28).value_to_string().c_str()) != 0;
+    live_params.noise_mode = std::stoi(params.at(29).value_to_string().c_str());
+    live_params.perturbation.f_low = std::stod(params.at(30).value_to_string().c_str());
+    live_params.perturbation.f_high = std::stod(params.at(31).value_to_string().c_str());
+    live_params.perturbation.correlation = std::stod(params.at(32).value_to_string().c_str());
+    live_params.perturbation.envelope = static_cast<EnvelopeType>(std::clamp(std::stoi(params.at(33).value_to_string().c_str()), 0, 3));
+    live_params.perturbation.seed = std::stoi(params.at(34).value_to_string().c_str());
+    live_params.noise_kernel = std::clamp(std::stoi(params.at(35).value_to_string().c_str()), 0, 4);
+    score_settings.half_score_error = std::stod(params.at(36).value_to_string().c_str());
+    write_trial_log = std::stoi(params.at(37).value_to_string().c_str());
+    use_calibration = std::stoi(params.at(38).value_to_string().c_str());
+    use_session = std::stoi(params.at(39).value_to_string().c_str());
+    std::vector<double> axes_amplitude = this->get_parameter("noise_axes_amplitude").as_double_array();
+    std::vector<double> joints_amplitude = this->get_parameter("noise_joints_amplitude").as_double_array();
+    std::vector<double> exponents = this->get_parameter("noise_exponents").as_double_array();
+    for (int c=0; c<num_cartesian_channels && c<(int) axes_amplitude.size(); c++) live_params.perturbation.amplitude[c] = axes_amplitude.at(c);
+    for (int c=0; c<num_joint_channels && c<(int) joints_amplitude.size(); c++) live_params.perturbation.amplitude[num_cartesian_channels + c] = joints_amplitude.at(c);
+    for (int c=0; c<num_perturbation_channels && c<(int) exponents.size(); c++) live_params.perturbation.exponent[c] = exponents.at(c);
+
+    // the output directories are not part of the repository, create them on a fresh setup
+    for (const std::string & dir : {participant_dir, trial_log_dir, phase_trace_dir}) {
+      std::error_code ec;
+      std::filesystem::create_directories(dir, ec);
+      if (ec) std::cerr << "Could not create " << dir << " (" << ec.message() << ")" << std::endl;
+    }
 
-    // overwrite alpha_id if the free drive mode is activated
-    if (free_drive == 1) alpha_id = 5;
+    // recover from an aborted run and take the condition from the session plan (if there is one)
+    if (use_session != 0 && !resume_session()) {
+      rclcpp::shutdown();
+      return;
+    }
+    int requested_alpha_id = alpha_id;
+
+    // overwrite alpha_id (and disable alpha adaptation) if the free drive mode is activated
+    if (free_drive == 1) {
+      alpha_id = 5;
+      adapt_alpha = 0;
+    }
+
+    // free drive trials calibrate (free_drive can also be switched on live), the others start from the participant's
+    // stored calibration (if any)
+    prepare_calibration();
+    if (free_drive == 0 && use_calibration != 0) load_calibration();
 
     print_params();
 
+    // build the initial trial configuration (alphas, reference table, noise vector, mapping) synchronously,
+    // later parameter changes are built by the live_config worker thread
+    live_params.free_drive = free_drive;
+    live_params.mapping_ratio = mapping_ratio;
+    live_params.use_depth = use_depth;
+    live_params.alpha_id = requested_alpha_id;   // as requested, free_drive overrides it in the build
+    live_params.traj_id = traj_id;
+    live_params.mapping = mapping_settings;
+    live_config.start([this](const LiveParams & p) { return build_trial_config(p); });
+    cfg = live_config.build_now(live_params);
+    if (cfg == nullptr) {
+      std::cout << "Could not build the trial configuration, shutting down now !!!" << std::endl;
+      rclcpp::shutdown();
+      return;
+    }
+    config_fade.build(config_fade_time * control_freq, BlendType::cubic);
+
     // update {ax, ay, az} values using the parameter "alpha_id"
-    ax = alphas_dict.at(alpha_id).at(0);
-    ay = alphas_dict.at(alpha_id).at(1);
-    az = alphas_dict.at(alpha_id).at(2);
+    ax = cfg->alpha[0];
+    ay = cfg->alpha[1];
+    az = cfg->alpha[2];
+
+    // continue from the participant's adapted alphas, if there are any
+    if (adapt_alpha != 0) {
+      ParticipantStore store(participant_dir, part_id);
+      std::vector<double> stored;
+      if (store.load() && store.get("alpha", stored) && stored.size() == 3) {
+        ax = stored.at(0); ay = stored.at(1); az = stored.at(2);
+        std::cout << "Adapted alphas loaded from " << store.path() << " = {" << ax << ", " << ay << ", " << az << "}\n" << std::endl;
+      }
+    }
     
     // also store them into the initial alpha values
     iax = ax;
     iay = ay;
     iaz = az;
 
-    // write the sine curve parameters
-    switch (traj_id) {
-      case 0: pa = 1; pb = 1; pc = 4; ps = M_PI;     ph = 0.25; nid = "8"; break;
-      case 1: pa = 2; pb = 3; pc = 4; ps = 4*M_PI/3; ph = 0.25; nid = "9"; break;
-      case 2: pa = 1; pb = 3; pc = 4; ps = M_PI;     ph = 0.25; nid = "7"; break;
-      case 3: pa = 2; pb = 2; pc = 5; ps = M_PI;     ph = 0.2;  nid = "5"; break;
-      case 4: pa = 2; pb = 3; pc = 5; ps = 8*M_PI/5; ph = 0.2;  nid = "2"; break;
-      case 5: pa = 2; pb = 4; pc = 5; ps = M_PI;     ph = 0.2;  nid = "4"; break;
-    }
+    // precompute the phase transition profiles
+    BlendType bt = static_cast<BlendType>(std::clamp(blend_type, 0, 2));
+    smoothing_blend.build(max_smoothing_count - control_freq * float_time, bt);
+    shifting_blend.build(max_shifting_count, bt);
+    homing_blend.build(max_homing_count, bt);
 
     // joint controller publisher & timer
     controller_pub_ = this->create_publisher<sensor_msgs::msg::JointState>("desired_joint_vals", 10);
-    controller_timer_ = this->create_wall_timer(2ms, std::bind(&RealController::controller_publisher, this));    // controls at 500 Hz
+    if (loop_mode == 0) {
+      controller_timer_ = this->create_wall_timer(2ms, std::bind(&RealController::timer_tick, this));    // controls at 500 Hz
+    } else if (loop_mode == 2) {
+      controller_timer_ = this->create_wall_timer(2ms, std::bind(&RealController::fallback_tick, this));    // fallback only
+    }
 
     // tcp position publisher & timer
     tcp_pos_pub_ = this->create_publisher<tutorial_interfaces::msg::PosInfo>("tcp_position", 10);
@@ -233,7 +539,9 @@ public:
 
     // recording flag publisher & timer
     record_flag_pub_ = this->create_publisher<std_msgs::msg::Bool>("record", 10);
-    record_flag_timer_ = this->create_wall_timer(2ms, std::bind(&RealController::record_flag_publisher, this));    // publishes at 500 Hz
+    if (loop_mode != 1) {
+      record_flag_timer_ = this->create_wall_timer(2ms, std::bind(&RealController::record_flag_publisher, this));    // publishes at 500 Hz
+    }
 
     // second_last_point publisher
     last_point_pub_ = this->create_publisher<std_msgs::msg::Bool>("last_point", 10);  // publishes only once
@@ -241,34 +549,423 @@ public:
     // controller count publisher, same frequency as the controller
     // count_pub_ = this->create_publisher<std_msgs::msg::Float64>("controller_count", 10);
 
+    // MPC solve statistics {mean [us], max [us], mean iterations, max iterations, not converged, solves}, once per second
+    mpc_stats_pub_ = this->create_publisher<std_msgs::msg::Float64MultiArray>("mpc_stats", 10);
+
+    // applied robot perturbation, published together with the tcp position
+    perturbation_pub_ = this->create_publisher<std_msgs::msg::Float64MultiArray>("perturbation", 10);
+    perturbation_msg.data.reserve(num_perturbation_channels);
+
+    // tracking score {score [0-100], recent score [0-100], RMS error [m], recent RMS error [m], max error [m],
+    // reference time from start [s], final (0/1), controller count, monotonic time [s]}, at score_pub_frequency while
+    // recording and once more at the end
+    score_pub_ = this->create_publisher<std_msgs::msg::Float64MultiArray>("tracking_score", 10);
+    score_msg.data.assign(9, 0.0);
+    tracking_score.configure(score_settings, control_freq);
+
+    // per-tick timing {scheduler tick, controller count, monotonic time since start [s], overruns, skipped ticks,
+    // fallback ticks (loop_mode 2: ticks run by the timer because no joint state came, 0 in the other loop modes)}
+    timing_pub_ = this->create_publisher<std_msgs::msg::Float64MultiArray>("controller_timing", 10);
+    timing_msg.data.assign(6, 0.0);
+
+    // phase trace ring, every span of every tick in the window, plus the writer's spare ring
+    size_t trace_capacity = (size_t) std::max(0, (int) (trace_window * control_freq)) * trace_spans_per_tick;
+    phase_trace.reserve(trace_capacity);
+    trace_markers.reserve(16);
+    trace_writer.start(trace_capacity, trace_markers.capacity());
+
     // countdown publisher, only publishes at whole second points during smoothing
     countdown_pub_ = this->create_publisher<std_msgs::msg::Float64>("countdown", 10);
 
+    // in wait-set mode the subscriptions live in a callback group that is never added to an executor,
+    // their messages are taken explicitly by run_wait_set_loop()
+    auto sub_options = rclcpp::SubscriptionOptions();
+    if (loop_mode == 1) sub_options.callback_group = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+
     joint_vals_sub_ = this->create_subscription<sensor_msgs::msg::JointState>(
-      "franka/joint_states", 10, std::bind(&RealController::joint_states_callback, this, std::placeholders::_1));
+      "franka/joint_states", 10, std::bind(&RealController::joint_states_callback, this, std::placeholders::_1), sub_options);
 
     falcon_pos_sub_ = this->create_subscription<tutorial_interfaces::msg::Falconpos>(
-      "falcon_position", 10, std::bind(&RealController::falcon_pos_callback, this, std::placeholders::_1));
+      "falcon_position", 10,
+      [this](const tutorial_interfaces::msg::Falconpos & msg, const rclcpp::MessageInfo & info) { falcon_pos_callback(msg, info); }, sub_options);
+
+    falcon_button_sub_ = this->create_subscription<std_msgs::msg::Bool>(
+      "falcon_button", 10, std::bind(&RealController::falcon_button_callback, this, std::placeholders::_1), sub_options);
+
+    // on-demand phase trace dump, default callback group so it is also serviced in the wait-set loop
+    dump_trace_sub_ = this->create_subscription<std_msgs::msg::Bool>(
+      "dump_phase_trace", 10, std::bind(&RealController::dump_trace_callback, this, std::placeholders::_1));
 
     //Create Panda tree and get its kinematic chain
     if (!create_tree()) rclcpp::shutdown();
     get_chain();
 
-    // read the noise data csv file
-    std::string noise_file {"noise" + nid + ".csv"};
-    generate_noise_vector(noise_file);
+    // forward kinematics of the measured joint states, solver and message are allocated once here
+    fk_solver = std::make_unique<KDL::ChainFkSolverPos_recursive>(panda_chain);
+    mpc_vel_solver = std::make_unique<KDL::ChainIkSolverVel_pinv>(panda_chain, 0.0001, 1000);
+    measured_msg.layout.dim.resize(2);
+    measured_msg.layout.dim.at(0).label = "sample";
+    measured_msg.layout.dim.at(0).size = measured_batch_size;
+    measured_msg.layout.dim.at(0).stride = measured_batch_size * measured_fields;
+    measured_msg.layout.dim.at(1).label = "field";
+    measured_msg.layout.dim.at(1).size = measured_fields;
+    measured_msg.layout.dim.at(1).stride = measured_fields;
+    measured_msg.data.assign(measured_batch_size * measured_fields, 0.0);
+    measured_tcp_pub_ = this->create_publisher<std_msgs::msg::Float64MultiArray>("measured_tcp", 10);
+
+    // validate live parameter changes here, the derived tables are built on the live_config worker
+    param_callback_handle_ = this->add_on_set_parameters_callback(
+      std::bind(&RealController::parameters_callback, this, std::placeholders::_1));
+
+    // trial log, preallocated for every control tick of the trial
+    if (write_trial_log != 0) open_trial_log();
+
+    // the attempt is on disk before the robot moves, a crash from here on is recovered on the next start
+    if (session != nullptr) {
+      session->begin({alpha_id, traj_id}, trial_log.path());
+      if (!session->save()) std::cerr << "Unable to write the session checkpoint " << session->path() << std::endl;
+      session_saver.start(session.get());
+    }
+
+    // switch this (control) thread to real-time and report what was granted, after all the tables are allocated
+    std::string rt_report;
+    bool rt_granted = apply_rt_settings(rt_settings, rt_report);
+    std::cout << "Real-time placement [real_controller]" << (rt_granted ? "" : " - NOT FULLY GRANTED") << ":\n" << rt_report << std::endl;
+  }
+
+  ~RealController()
+  {
+    session_saver.stop();
+    live_config.stop();
+    trial_log.close();
+  }
+
+  bool uses_wait_set() const { return loop_mode == 1; }
+
+  ///////////////////////////////////// WAIT-SET CONTROL LOOP /////////////////////////////////////
+  // deterministic read -> compute -> write: wait for a sample or the tick deadline, take every pending
+  // sample, then run one controller tick and publish, all on this thread
+  void run_wait_set_loop()
+  {
+    rclcpp::WaitSet wait_set;
+    wait_set.add_subscription(joint_vals_sub_);
+    wait_set.add_subscription(falcon_pos_sub_);
+    wait_set.add_subscription(falcon_button_sub_);
+
+    // only services the node's default callback group (parameter services), the subscriptions are excluded
+    rclcpp::executors::SingleThreadedExecutor executor;
+    executor.add_node(this->shared_from_this());
+
+    start_scheduler();
+
+    while (rclcpp::ok()) {
+      auto timeout = scheduler.next_deadline() - std::chrono::steady_clock::now();
+      if (timeout > std::chrono::nanoseconds(0)) {
+        auto wait_result = wait_set.wait(timeout);
+        if (wait_result.kind() == rclcpp::WaitResultKind::Ready) take_samples();
+        continue;
+      }
+
+      take_samples();
+      long overruns_before = scheduler.overruns();
+      int ticks = scheduler.due(std::chrono::steady_clock::now());
+      if (scheduler.overruns() != overruns_before) deadline_missed();
+      for (int k=0; k<ticks && rclcpp::ok(); k++) {
+        controller_publisher();
+        record_flag_publisher();
+        publish_timing(scheduler.ticks() - ticks + k, scheduler.overruns(), scheduler.skipped());
+      }
+
+      executor.spin_some(std::chrono::nanoseconds(0));
+    }
   }
 
 private:
+
+  ///////////////////////////////////// SCHEDULED TICKS /////////////////////////////////////
+  void start_scheduler()
+  {
+    const auto period = std::chrono::microseconds(1000000 / control_freq);
+    scheduler.start(std::chrono::steady_clock::now(), period, static_cast<TickPolicy>(std::clamp(tick_policy, 0, 2)), tick_max_burst);
+    scheduler_started = true;
+  }
+
+  // wall-timer driven: the timer only wakes the loop up, the scheduler decides how many ticks are due
+  void timer_tick()
+  {
+    if (!scheduler_started) start_scheduler();
+    long overruns_before = scheduler.overruns();
+    int ticks = scheduler.due(std::chrono::steady_clock::now());
+    for (int k=0; k<ticks && rclcpp::ok(); k++) {
+      controller_publisher();
+      publish_timing(scheduler.ticks() - ticks + k, scheduler.overruns(), scheduler.skipped());
+    }
+    if (scheduler.overruns() != overruns_before) deadline_missed();   // counted in controller_timing
+  }
+
+  void publish_timing(long tick, long overruns, long skipped, long fallbacks = 0)
+  {
+    double * d = timing_msg.data.data();
+    d[0] = (double) tick;
+    d[1] = (double) count;
+    d[2] = monotonic_seconds(std::chrono::steady_clock::now());
+    d[3] = (double) overruns;
+    d[4] = (double) skipped;
+    d[5] = (double) fallbacks;
+    timing_pub_->publish(timing_msg);
+  }
+
+  double monotonic_seconds(std::chrono::steady_clock::time_point t) const
+  {
+    return std::chrono::duration<double>(t - control_epoch).count();
+  }
+
+  ///////////////////////////////////// LIVE PARAMETER UPDATES /////////////////////////////////////
+  // executor thread: validate only, the tables are built on the live_config worker so no tick ever waits for them
+  rcl_interfaces::msg::SetParametersResult parameters_callback(const std::vector<rclcpp::Parameter> & parameters)
+  {
+    rcl_interfaces::msg::SetParametersResult result;
+    LiveParams p = live_params;
+    try {
+      for (const auto & param : parameters) {
+        const std::string & name = param.get_name();
+        if (name == "free_drive") p.free_drive = std::stoi(param.value_to_string().c_str());
+        else if (name == "mapping_ratio") p.mapping_ratio = std::stod(param.value_to_string().c_str());
+        else if (name == "use_depth") p.use_depth = std::stoi(param.value_to_string().c_str());
+        else if (name == "alpha_id") p.alpha_id = std::stoi(param.value_to_string().c_str());
+        else if (name == "traj_id") p.traj_id = std::stoi(param.value_to_string().c_str());
+        else {
+          result.successful = false;
+          result.reason = name + " can only be set at startup";
+          return result;
+        }
+      }
+    } catch (const std::exception &) {
+      result.successful = false;
+      result.reason = "not a number";
+      return result;
+    }
+
+    if (p.free_drive != 0 && p.free_drive != 1) result.reason = "free_drive must be 0 or 1";
+    else if (p.use_depth != 0 && p.use_depth != 1) result.reason = "use_depth must be 0 or 1";
+    else if (p.mapping_ratio <= 0.0) result.reason = "mapping_ratio must be positive";
+    else if (p.alpha_id < 0 || p.alpha_id >= (int) alphas_dict.size()) result.reason = "alpha_id out of range";
+    else if (p.traj_id < 0 || p.traj_id > 5) result.reason = "traj_id out of range";
+    else if (origin_held && !task_origins.same(p.traj_id, live_params.traj_id)) {
+      result.reason = "traj_id " + std::to_string(p.traj_id) + " has another origin, it can only change before control starts";
+    }
+    else if (adapt_alpha != 0 && (p.alpha_id != live_params.alpha_id || p.free_drive != live_params.free_drive)) {
+      result.reason = "the alphas are adapted, alpha_id / free_drive cannot change";
+    }
+    else if (session_plan_active && (p.alpha_id != live_params.alpha_id || p.traj_id != live_params.traj_id || p.free_drive != live_params.free_drive)) {
+      result.reason = "a session plan is running, alpha_id / traj_id / free_drive are fixed by it";
+    }
+    if (!result.reason.empty()) {
+      result.successful = false;
+      return result;
+    }
+
+    live_params = p;
+    live_config.request(p);
+    return result;
+  }
+
+  // live_config worker (and once from the constructor): everything here is read-only on the node
+  std::unique_ptr<TrialConfig> build_trial_config(const LiveParams & p) const
+  {
+    auto c = std::make_unique<TrialConfig>();
+    c->params = p;
+
+    // free drive mode overrides the alphas (fully human)
+    int a_id = (p.free_drive == 1) ? 5 : p.alpha_id;
+    for (int i=0; i<3; i++) c->alpha[i] = alphas_dict.at(a_id).at(i);
+
+    // write the sine curve parameters and the matching noise file index
+    get_sine_sum_params(p.traj_id, c->traj_params);
+    c->traj_params.use_depth = p.use_depth;
+    switch (p.traj_id) {
+      case 0: c->nid = "8"; break;
+      case 1: c->nid = "9"; break;
+      case 2: c->nid = "7"; break;
+      case 3: c->nid = "5"; break;
+      case 4: c->nid = "2"; break;
+      case 5: c->nid = "4"; break;
+    }
+
+    // precompute the reference offset for every tick of the recording
+    const SineSumParams & tp = c->traj_params;
+    c->reference.build([&tp](double t, double * xyz) { sine_sum_offset(tp, t, xyz); }, max_recording_count, arc_length == 1);
+    std::cout << "Reference length = " << c->reference.length() << " [m], mean speed = "
+              << c->reference.length() / traj_duration << " [m/s]\n" << std::endl;
+
+    if (p.noise_mode == 0) {
+      // read the noise data csv file, z axis only
+      std::vector<double> noise = generate_noise_vector("noise" + c->nid + ".csv", static_cast<KernelType>(p.noise_kernel));
+      if ((int) noise.size() <= max_recording_count) {
+        std::cout << "Noise vector too short (" << noise.size() << "), configuration rejected" << std::endl;
+        return nullptr;
+      }
+      c->perturbation.build_from_channel(2, noise, max_recording_count);
+    } else {
+      // spectral perturbations, a different (but reproducible) realization per trajectory
+      PerturbationSettings ps = p.perturbation;
+      ps.seed = ps.seed * 16 + p.traj_id;
+      c->perturbation.build(ps, max_recording_count, control_freq);
+    }
+
+    MappingSettings m = p.mapping;
+    m.mapping_ratio = p.mapping_ratio;
+    c->scaling.configure(m);
+    task_origins.get(p.traj_id, c->origin);
+    return c;
+  }
+
+  // control thread, start of every tick: one atomic load, the swap itself is a few assignments
+  void adopt_live_config()
+  {
+    TrialConfig * next = live_config.poll(cfg);
+    if (next != nullptr) {
+      prev_cfg = cfg;
+      cfg = next;
+      config_fade_count = control ? 0 : config_fade.num_ticks();   // nothing moves before control starts, swap directly
+      fade_alpha_from[0] = ax; fade_alpha_from[1] = ay; fade_alpha_from[2] = az;
+      free_drive = cfg->params.free_drive;
+      mapping_ratio = cfg->params.mapping_ratio;
+      use_depth = cfg->params.use_depth;
+      alpha_id = cfg->params.alpha_id;
+      traj_id = cfg->params.traj_id;
+      // parameters_callback rejects another origin once control starts, a request that raced it keeps the current one
+      if (!control) for (int i=0; i<3; i++) origin.at(i) = cfg->origin[i];
+      if (session != nullptr) update_session_condition();
+      if (adapt_alpha == 0) { iax = cfg->alpha[0]; iay = cfg->alpha[1]; iaz = cfg->alpha[2]; }
+      if (!control) { ax = iax; ay = iay; az = iaz; }
+      std::cout << "Live parameter update: free_drive = " << free_drive << ", mapping_ratio = " << mapping_ratio << ", use_depth = "
+                << use_depth << ", alpha_id = " << alpha_id << ", traj_id = " << traj_id << std::endl;
+    }
+
+    if (!config_fading()) return;
+    config_fade_count++;
+    // fade the alphas, the shifting phase takes over from iax/iay/iaz on its own
+    if (adapt_alpha == 0 && count <= max_smoothing_count + max_recording_count) {
+      double w = config_fade.at(config_fade_count);
+      ax = (1-w) * fade_alpha_from[0] + w * iax;
+      ay = (1-w) * fade_alpha_from[1] + w * iay;
+      az = (1-w) * fade_alpha_from[2] + w * iaz;
+    }
+  }
+
+  bool config_fading() const { return prev_cfg != nullptr && config_fade_count < config_fade.num_ticks(); }
+
+  // weight of the active configuration, 1.0 outside of a cross-fade
+  double config_weight() const { return config_fading() ? config_fade.at(config_fade_count) : 1.0; }
+
+  ///////////////////////////////////// PHASE TRACE /////////////////////////////////////
+  int64_t monotonic_ns(std::chrono::steady_clock::time_point t) const
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t - control_epoch).count();
+  }
+
+  // closes the current phase of this tick and starts the next one, tick = count at the start of the tick
+  void end_phase(long tick, TickPhase phase)
+  {
+    auto now = std::chrono::steady_clock::now();
+    phase_trace.record(tick, phase, monotonic_ns(phase_start), monotonic_ns(now));
+    phase_start = now;
+  }
+
+  void deadline_missed()
+  {
+    int64_t now_ns = monotonic_ns(std::chrono::steady_clock::now());
+    if (trace_markers.size() < trace_markers.capacity()) trace_markers.push_back({now_ns, "deadline miss"});
+    // at most one automatic dump per trace window, so consecutive misses end up in the same file
+    if (last_trace_dump_ns >= 0 && now_ns - last_trace_dump_ns < (int64_t) (trace_window * 1e9)) return;
+    dump_phase_trace("deadline_miss");
+  }
+
+  // the ring is handed to the trace writer thread (buffer swap, no copy or allocation here), it writes the json
+  void dump_phase_trace(const char * reason)
+  {
+    if (phase_trace.size() == 0) return;
+    char path[512];
+    std::snprintf(path, sizeof(path), "%spart%d_traj%d_tick%d_%s.json", phase_trace_dir.c_str(), part_id, traj_id, count, reason);
+    if (trace_writer.request(phase_trace, trace_markers, path)) last_trace_dump_ns = monotonic_ns(std::chrono::steady_clock::now());
+  }
+
+  void dump_trace_callback(const std_msgs::msg::Bool & msg)
+  {
+    if (msg.data) dump_phase_trace("on_demand");
+  }
+
+  ///////////////////////////////////// JOINT-STATE TRIGGERED TICKS /////////////////////////////////////
+  void triggered_tick(bool from_joint_state)
+  {
+    auto now = std::chrono::steady_clock::now();
+    const auto period = std::chrono::microseconds(1000000 / control_freq);
+    if (last_tick_time == std::chrono::steady_clock::time_point()) last_tick_time = now - period;
+
+    if (from_joint_state) {
+      if (now - last_tick_time < period * 9 / 10) return;    // joint states faster than the control rate
+      last_tick_time = now;                                   // the samples set the phase of the tick grid
+      joint_states_expected = true;
+      triggered_ticks++;
+      run_triggered_tick();
+      return;
+    }
+
+    // fallback: take over every tick whose deadline has passed (after the slack, if a joint state could still come)
+    int ticks = 0;
+    while (now - last_tick_time >= (joint_states_expected ? period * 3 / 2 : period) && rclcpp::ok()) {
+      last_tick_time += period;
+      joint_states_expected = false;
+      fallback_ticks++;
+      run_triggered_tick();
+      if (++ticks == tick_max_burst) {
+        last_tick_time = now;   // too far behind, drop the rest and restart the grid here
+        break;
+      }
+    }
+    if (ticks > 2) {   // 2 = timer granularity, more means the timer itself was late
+      triggered_overruns += ticks - 2;
+      deadline_missed();
+    }
+  }
+
+  void run_triggered_tick()
+  {
+    controller_publisher();
+    publish_timing(triggered_ticks + fallback_ticks - 1, triggered_overruns, 0, fallback_ticks);
+
+    if ((triggered_ticks + fallback_ticks) % (10 * control_freq) == 0) {
+      std::cout << "Ticks triggered by joint states = " << triggered_ticks << ", by the fallback timer = " << fallback_ticks << std::endl;
+    }
+  }
+
+  void fallback_tick() { triggered_tick(false); }
+
+  void take_samples()
+  {
+    rclcpp::MessageInfo info;
+    sensor_msgs::msg::JointState joint_msg;
+    while (joint_vals_sub_->take(joint_msg, info)) joint_states_callback(joint_msg);
+    tutorial_interfaces::msg::Falconpos falcon_msg;
+    while (falcon_pos_sub_->take(falcon_msg, info)) falcon_pos_callback(falcon_msg, info);
+    std_msgs::msg::Bool button_msg;
+    while (falcon_button_sub_->take(button_msg, info)) falcon_button_callback(button_msg);
+  }
   
   ///////////////////////////////////// JOINT CONTROLLER /////////////////////////////////////
   void controller_publisher()
   { 
+    adopt_live_config();
+
     if (!control) {
 
       prep_count++;
       if (prep_count % control_freq == 0) std::cout << "The prep_count is currently " << prep_count << "\n" << std::endl; 
-      if (prep_count == max_prep_count) control = true;
+      if (prep_count == max_prep_count) {
+        control = true;
+        origin_held = true;
+      }
 
       if (prep_count > max_prep_count - control_freq*2) {
         ///////// warm-up the wait-set 2 seconds before actual control /////////
@@ -280,46 +977,67 @@ private:
       
 
     } else {
+      phase_start = std::chrono::steady_clock::now();
+      const long tick = count;   // count is advanced mid-tick, every span / tracepoint of this tick uses the value at its start
+
+      // get the robot control offset in Cartesian space (from the precomputed reference table)
+      int within_traj_count = std::clamp(count - max_smoothing_count, 0, max_recording_count);
+      t_param = cfg->reference.t_at(within_traj_count);   // t_param is in the range [0, 2pi]
+      get_robot_control(within_traj_count);
 
-      // get the robot control offset in Cartesian space (calling the corresponding function of the traj_id)
-      t_param = (double) (count - max_smoothing_count) / max_recording_count * 2 * M_PI;   // t_param is in the range [0, 2pi], but can be out of range
-      get_robot_control(t_param);      
+      if (alpha_ramp_count >= 0 && count <= max_smoothing_count + max_recording_count) step_alpha_ramp();
 
-      // gradually change control authority to fully robot after 10 second trajectory
+      // gradually change control authority to fully robot after 10 second trajectory, starting from wherever a
+      // ramp / cross-fade left the alphas
+      if (count == max_smoothing_count + max_recording_count + 1) {
+        shift_from[0] = ax; shift_from[1] = ay; shift_from[2] = az;
+      }
       if (count > max_smoothing_count+max_recording_count && count <= max_smoothing_count+max_recording_count+max_shifting_count) {
-        double shift_t = (double) (count - max_smoothing_count - max_recording_count) / max_shifting_count;
-        ax = (1.0 - shift_t) * iax;
-        ay = (1.0 - shift_t) * iay;
-        az = (1.0 - shift_t) * iaz;
+        double shift_t = shifting_blend.at(count - max_smoothing_count - max_recording_count);
+        ax = (1.0 - shift_t) * shift_from[0];
+        ay = (1.0 - shift_t) * shift_from[1];
+        az = (1.0 - shift_t) * shift_from[2];
       }
       // write the joint values at the final trajectory position
       if (count == max_smoothing_count+max_recording_count+max_shifting_count) {
         for (size_t i=0; i<7; i++) final_joint_vals.at(i) = curr_joint_vals.at(i);
       }
       
-      // perform the convex combination of robot and human offsets
-      // also adding the origin and thus representing it as tcp_pos in the robot's base frame
-      tcp_pos.at(0) = origin.at(0) + ax * human_offset.at(0) + (1-ax) * robot_offset.at(0);
-      tcp_pos.at(1) = origin.at(1) + ay * human_offset.at(1) + (1-ay) * robot_offset.at(1);
-      tcp_pos.at(2) = origin.at(2) + az * human_offset.at(2) + (1-az) * robot_offset.at(2);
+      if (control_mode == 1) {
+        // optimize the next ticks of TCP offsets, result written into tcp_pos
+        compute_mpc_target(count - max_smoothing_count);
+      } else {
+        // perform the convex combination of robot and human offsets
+        // also adding the origin and thus representing it as tcp_pos in the robot's base frame
+        tcp_pos.at(0) = origin.at(0) + ax * human_offset.at(0) + (1-ax) * robot_offset.at(0);
+        tcp_pos.at(1) = origin.at(1) + ay * human_offset.at(1) + (1-ay) * robot_offset.at(1);
+        tcp_pos.at(2) = origin.at(2) + az * human_offset.at(2) + (1-az) * robot_offset.at(2);
+      }
+
+      ///////// accumulate tracking error & disagreement for the alpha adaptation /////////
+      if (record_flag && adapt_alpha != 0) update_alpha_adaptation();
+      if (record_flag) update_tracking_score();
+      if (record_flag) check_falcon_stream();
 
       ///////// compute IK /////////
+      end_phase(tick, TickPhase::control);
+      HRI_TRACE(ik_start, tick);
       compute_ik(tcp_pos, curr_joint_vals, ik_joint_vals);
+      HRI_TRACE(ik_end, tick);
+      // joint perturbations only within the recording, outside it the clamped row 0 / last row would offset the robot
+      if (record_flag) apply_joint_perturbation(within_traj_count);
+      end_phase(tick, TickPhase::ik);
 
       ///////////// publish the tcp position message /////////////
       if (record_flag && ((count - max_smoothing_count) % (control_freq / 40) == 0)) RealController::tcp_pos_publisher();
+      end_phase(tick, TickPhase::logging);
 
       ///////// initial smooth transitioning from current position to Falcon-mapped position /////////
       count++;  // increase count
 
       if (count <= max_smoothing_count) {
-        double ratio = 0.0;
-        if (count <= max_smoothing_count - control_freq * float_time) {
-          // get lerp position using time
-          ratio = (double) count / (max_smoothing_count - control_freq * float_time);    // need to get there early and "float"
-        } else {
-          ratio = 1.0;
-        }
+        // blend position using time, saturates at 1.0 to get there early and "float"
+        double ratio = smoothing_blend.at(count);
         // std::cout << "The smoothing ratio is " << ratio << std::endl;
 
         for (unsigned int i=0; i<n_joints; i++) message_joint_vals.at(i) = ratio * ik_joint_vals.at(i) + (1-ratio) * initial_joint_vals.at(i);
@@ -330,12 +1048,7 @@ private:
 
       // bring it home boys
       if (count > max_smoothing_count + max_recording_count + max_shifting_count) {
-        double hr = 0.0;
-        if (count <= max_smoothing_count + max_recording_count + max_shifting_count + max_homing_count) {
-          hr = (double) (count - max_smoothing_count - max_recording_count - max_shifting_count) / max_homing_count;
-        } else {
-          hr = 1.0;
-        }
+        double hr = homing_blend.at(count - max_smoothing_count - max_recording_count - max_shifting_count);
         for (size_t i=0; i<7; i++) message_joint_vals.at(i) = hr * home_joint_vals.at(i) + (1-hr) * final_joint_vals.at(i);
       }
       // shutdown down 1 second after homing
@@ -347,17 +1060,22 @@ private:
       ///////// check limits /////////
       if (!within_limits(message_joint_vals)) {
         std::cout << "--------\nThese violate the joint limits of the Panda arm, shutting down now !!!\n---------" << std::endl;
+        if (session != nullptr) std::cout << "Session progress is kept in " << session->path() << ", restart with the same part_id to continue" << std::endl;
         rclcpp::shutdown();
       }
 
       ///////// prepare and publish the desired_joint_vals message /////////
       auto q_desired = sensor_msgs::msg::JointState();
+      q_desired.header.stamp = this->now();
       q_desired.position = message_joint_vals;
       controller_pub_->publish(q_desired);
+      HRI_TRACE(command_publish, tick);
+      end_phase(tick, TickPhase::publish);
 
       // set the record flag as true
       if ((count == max_smoothing_count) && (!record_flag)) {
         record_flag = true;
+        tracking_score.reset();
         std::cout << "\n\n\n\n\n\n======================= RECORD FLAG IS SET TO => TRUE =======================\n\n\n\n\n\n" << std::endl;
       }
 
@@ -365,6 +1083,12 @@ private:
       if ((count == max_smoothing_count + max_recording_count) && (record_flag == true)) {
         std::cout << "\n\n\n\n\n\n======================= RECORD FLAG IS SET TO => FALSE =======================\n\n\n\n\n\n" << std::endl;
         record_flag = false; 
+        if (adapt_alpha != 0) finish_alpha_adaptation();
+        if (free_drive == 1) finish_calibration();
+        publish_tracking_score(true);
+        std::cout << "Tracking score = " << tracking_score.score() << " (RMS error = " << tracking_score.rms()
+                  << " [m], max error = " << tracking_score.max_error() << " [m])\n" << std::endl;
+        if (session != nullptr) finish_session();
       }
 
       // ///////////// publish the controller count message /////////////
@@ -378,6 +1102,8 @@ private:
         count_msg.data = count / control_freq;
         countdown_pub_->publish(count_msg);
       }
+      log_tick(tick);
+      end_phase(tick, TickPhase::logging);
     }
   }
 
@@ -418,9 +1144,16 @@ private:
       tcp_pos.at(2)
     };
 
-    message.time_from_start = (double) (count - max_smoothing_count) / max_recording_count * 10;    // out of total of 10 seconds
+    // reference time of this tick (out of a total of 10 seconds): exactly the tick that indexed ref_position, so the
+    // tick is recoverable as time_from_start * control_freq + max_smoothing_count and joins controller_timing
+    message.time_from_start = (double) (count - max_smoothing_count) / control_freq;
 
     tcp_pos_pub_->publish(message);
+
+    // the perturbation applied at this tick {x, y, z [m], joints 1-7 [rad]}
+    const double * p = cfg->perturbation.at(std::clamp(count - max_smoothing_count, 0, max_recording_count));
+    perturbation_msg.data.assign(p, p + num_perturbation_channels);
+    perturbation_pub_->publish(perturbation_msg);
     
   }
 
@@ -435,10 +1168,12 @@ private:
   ///////////////////////////////////// JOINT STATES SUBSCRIBER /////////////////////////////////////
   void joint_states_callback(const sensor_msgs::msg::JointState & msg)
   { 
-    auto data = msg.position;
+    HRI_TRACE(joint_state_receive, joint_state_count++);
+    const auto & data = msg.position;
     for (unsigned int i=0; i<n_joints; i++) {
       curr_joint_vals.at(i) = data.at(i);
     }
+    measure_tcp(msg);
     // get and store initial joint values if haven't received enough messages
     if (initial_joint_vals_count < required_initial_vals) {
       for (unsigned int i=0; i<n_joints; i++) {
@@ -448,44 +1183,434 @@ private:
 
       // print_joint_vals(initial_joint_vals);
     }
+
+    // compute the next command right away from this (freshest) sample
+    if (loop_mode == 2) triggered_tick(true);
+  }
+
+  // one row of the measured_tcp batch per joint-state sample, the batch is published when full
+  void measure_tcp(const sensor_msgs::msg::JointState & msg)
+  {
+    if (!fk_solver) return;
+    for (unsigned int i=0; i<n_joints; i++) fk_joints(i) = msg.position.at(i);
+    fk_solver->JntToCart(fk_joints, fk_frame);
+
+    double * row = measured_msg.data.data() + measured_in_batch * measured_fields;
+    row[0] = msg.header.stamp.sec + msg.header.stamp.nanosec * 1e-9;
+    row[1] = monotonic_seconds(std::chrono::steady_clock::now());
+    for (int i=0; i<3; i++) row[2 + i] = fk_frame.p(i);
+    for (int i=0; i<3; i++) row[5 + i] = tcp_pos.at(i);
+
+    if (++measured_in_batch == measured_batch_size) {
+      measured_tcp_pub_->publish(measured_msg);
+      measured_in_batch = 0;
+    }
   }
 
   ///////////////////////////////////// FALCON SUBSCRIBER /////////////////////////////////////
-  void falcon_pos_callback(const tutorial_interfaces::msg::Falconpos & msg)
+  void falcon_pos_callback(const tutorial_interfaces::msg::Falconpos & msg, const rclcpp::MessageInfo & info)
   { 
-    human_offset.at(0) = msg.x / 100 * mapping_ratio;
-    human_offset.at(1) = msg.y / 100 * mapping_ratio;
-    human_offset.at(2) = msg.z / 100 * mapping_ratio;
+    HRI_TRACE(falcon_receive, msg.x, msg.y, msg.z);
+    int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - control_epoch).count();
+    int64_t prev_ns = last_falcon_ns.exchange(now_ns, std::memory_order_relaxed);
+
+    // interval to the previous sample for the PRISM speed and the rate control, from the publication stamps if the
+    // middleware sets them (samples drained together in one tick share their arrival time), else from the arrival
+    // times; clamped like in position_talker, so a stalled stream does not integrate one large rate-control step
+    int64_t stamp_ns = info.get_rmw_message_info().source_timestamp;
+    bool stamped = stamp_ns > 0 && last_falcon_stamp_ns > 0;
+    double dt = 1.0 / control_freq;   // first sample
+    if (stamped || prev_ns >= 0) dt = std::clamp((stamped ? stamp_ns - last_falcon_stamp_ns : now_ns - prev_ns) * 1e-9, 0.1 / control_freq, 10.0 / control_freq);
+    last_falcon_stamp_ns = stamp_ns;
+
+    double device[3] {msg.x, msg.y, msg.z};   // in [cm]
+    if (free_drive == 1 && record_flag) calibration.add_sample(device);
+    cfg->scaling.map(device, dt, mapped_falcon);
+    if (config_fading()) {
+      // keep mapping the old way too and cross-fade, so a mapping_ratio change does not step the human offset
+      double old_mapped[3];
+      prev_cfg->scaling.map(device, dt, old_mapped);
+      double w = config_weight();
+      for (int i=0; i<3; i++) mapped_falcon[i] = (1-w) * old_mapped[i] + w * mapped_falcon[i];
+    }
+
+    // clutching / rate control, the whole human_offset is rewritten within this callback
+    double target[3];
+    indexing.update(device, mapped_falcon, dt, indexing_settings, target);
+    for (int i=0; i<3; i++) human_offset.at(i) = target[i];
+  }
+
+  ///////////////////////////////////// FALCON BUTTON SUBSCRIBER /////////////////////////////////////
+  void falcon_button_callback(const std_msgs::msg::Bool & msg)
+  {
+    bool was_clutched = indexing.clutched();
+    indexing.set_button(msg.data, mapped_falcon, indexing_settings);
+    if (indexing.clutched() != was_clutched) {
+      std::cout << (indexing.clutched() ? "Clutch engaged, robot target frozen" : "Clutch released, offsets re-baselined") << std::endl;
+    }
   }
 
   /////////////////////////////// robot control function ///////////////////////////////
-  void get_robot_control(double t) 
+  void get_robot_control(int within_traj_count) 
   { 
-    int within_traj_count = count - max_smoothing_count;
+    // within_traj_count is already clamped to [0, max_recording_count] = [0, 5000]
+
+    // look up the reference position and assign into ref_position vector
+    const double * ref = cfg->reference.offset_at(within_traj_count);
+    double w = config_weight();
+    const double * old_ref = config_fading() ? prev_cfg->reference.offset_at(within_traj_count) : ref;
+    ref_offset.at(0) = (1-w) * old_ref[0] + w * ref[0];
+    ref_offset.at(1) = (1-w) * old_ref[1] + w * ref[1];
+    ref_offset.at(2) = (1-w) * old_ref[2] + w * ref[2];
+
+    // compute robot target = reference position + noise
+    for (int i=0; i<3; i++) robot_offset.at(i) = robot_target(i, within_traj_count);
+  }
 
-    // make sure t = [0, 2pi], wtj = [0, 5000]
-    if (t < 0.0) {t = 0.0; within_traj_count = 0;}
-    if (t > 2*M_PI) {t = 2*M_PI; within_traj_count = 5000;}
+  // robot target offset (reference + noise) on axis i at the given tick of the trajectory, clamped to the recording
+  double robot_target(int i, int traj_count) const
+  {
+    int j = std::clamp(traj_count, 0, max_recording_count);
+    double target = config_target(*cfg, i, j);
+    if (config_fading()) {
+      double w = config_weight();
+      target = (1-w) * config_target(*prev_cfg, i, j) + w * target;
+    }
+    return target;
+  }
 
-    // assign the noise
-    double noise = robot_noise_vector.at(within_traj_count);
-    if (within_traj_count%100==0) std::cout << "noise_value = " << noise << std::endl;
+  // joint-space perturbation, added on top of the IK solution
+  void apply_joint_perturbation(int traj_count)
+  {
+    const double * p = cfg->perturbation.at(traj_count) + num_cartesian_channels;
+    const double * old_p = config_fading() ? prev_cfg->perturbation.at(traj_count) + num_cartesian_channels : p;
+    double w = config_weight();
+    for (unsigned int i=0; i<n_joints; i++) ik_joint_vals.at(i) += (1-w) * old_p[i] + w * p[i];
+  }
 
-    // compute reference position and assign into ref_position vector
-    ref_offset.at(0) = 0.0;
-    if (use_depth) ref_offset.at(0) = abs(t-M_PI) / M_PI * depth - (depth/2);
-    ref_offset.at(1) = t / (2*M_PI) * width - (width/2);
-    ref_offset.at(2) = (ph*height) * (sin(pa*(t+ps)) + sin(pb*(t+ps)) + sin(pc*(t+ps)));
+  static double config_target(const TrialConfig & c, int i, int j)
+  {
+    double target = c.reference.offset_at(j)[i];
+    target += c.perturbation.at(j)[i];
+    return target;
+  }
 
-    // compute robot target = reference position + noise
-    robot_offset.at(0) = ref_offset.at(0);
-    robot_offset.at(1) = ref_offset.at(1);
-    robot_offset.at(2) = ref_offset.at(2) + noise;
-    // robot_offset.at(2) = ref_offset.at(2);
+  /////////////////////////////// trial log functions ///////////////////////////////
+  void open_trial_log()
+  {
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+    std::string path = trial_log_dir + "part" + std::to_string(part_id) + "_alpha" + std::to_string(alpha_id) +
+                       "_traj" + std::to_string(traj_id) + "_" + stamp + ".hlog";
+
+    TrialLogHeader header;
+    header.control_freq = control_freq;
+    header.part_id = part_id;
+    header.alpha_id = alpha_id;
+    header.traj_id = traj_id;
+    header.use_depth = use_depth;
+    header.arc_length = arc_length;
+    header.free_drive = free_drive;
+    header.mapping_ratio = mapping_ratio;
+    for (int i=0; i<3; i++) header.origin[i] = origin.at(i);
+
+    long capacity = max_smoothing_count + max_recording_count + max_shifting_count + max_homing_count + max_shutdown_count + 1;
+    if (trial_log.open(path, header, capacity)) std::cout << "Trial log = " << path << "\n" << std::endl;
+    else std::cout << "Could not open the trial log " << path << ", not logging this trial\n" << std::endl;
+  }
+
+  // control thread, once per control tick: fills a preallocated record, the file is written by the log's own thread
+  // tick = count at the start of the tick, i.e. the one that indexed the reference
+  void log_tick(long tick)
+  {
+    TrialLogRecord * r = trial_log.next();
+    if (r == nullptr) return;
+
+    r->tick = tick;
+    if (tick < max_smoothing_count) r->phase = (int32_t) TrialPhase::smoothing;
+    else if (tick < max_smoothing_count + max_recording_count) r->phase = (int32_t) TrialPhase::recording;
+    else if (tick < max_smoothing_count + max_recording_count + max_shifting_count) r->phase = (int32_t) TrialPhase::shifting;
+    else r->phase = (int32_t) TrialPhase::homing;
+    int32_t phase = r->phase;
+    r->flags = (record_flag ? trial_log_record_flag : 0) | (indexing.clutched() ? trial_log_clutched_flag : 0);
+
+    r->time = monotonic_seconds(std::chrono::steady_clock::now());
+    r->time_from_start = (double) (tick - max_smoothing_count) / control_freq;
+    for (int i=0; i<3; i++) {
+      r->ref[i] = origin.at(i) + ref_offset.at(i);
+      r->human[i] = origin.at(i) + human_offset.at(i);
+      r->robot[i] = origin.at(i) + robot_offset.at(i);
+      r->tcp[i] = tcp_pos.at(i);
+    }
+    r->alpha[0] = ax; r->alpha[1] = ay; r->alpha[2] = az;
+    for (unsigned int i=0; i<n_joints; i++) {
+      r->joints_measured[i] = curr_joint_vals.at(i);
+      r->joints_commanded[i] = message_joint_vals.at(i);
+    }
+    trial_log.commit();
+
+    // fsync at every phase boundary, a crash loses at most the phase that was running
+    if (phase != last_log_phase) {
+      trial_log.sync();
+      last_log_phase = phase;
+    }
+  }
+
+  /////////////////////////////// session checkpoint functions ///////////////////////////////
+  // returns false if the planned session is already complete, or if this node was not started with the planned
+  // condition (marker_publisher draws the trajectory from its own traj_id, so both have to be restarted with it)
+  bool resume_session()
+  {
+    session = std::make_unique<SessionCheckpoint>(participant_dir, part_id);
+    session->load();
+    std::vector<int64_t> plan_param = this->get_parameter("session_plan").as_integer_array();
+    if (plan_param.size() >= 2) {
+      std::vector<SessionCondition> plan;
+      for (size_t i=0; i+1<plan_param.size(); i+=2) plan.push_back({(int) plan_param.at(i), (int) plan_param.at(i+1)});
+      session->set_plan(plan);
+      if (!session->save()) std::cerr << "Unable to write the session checkpoint " << session->path() << std::endl;
+    }
+
+    if (session->recovered()) {
+      const SessionEntry & e = session->aborted().back();
+      std::cout << "The previous run (alpha ID = " << e.condition.alpha_id << ", trajectory ID = " << e.condition.traj_id
+                << ") did not finish, its partial trial log is " << e.log << "\n" << std::endl;
+    }
+    if (free_drive == 1 || session->plan().empty()) return true;
+
+    SessionCondition next;
+    if (!session->next(next)) {
+      std::cout << "All " << session->plan().size() << " conditions of the session in " << session->path()
+                << " are done, shutting down now !!!" << std::endl;
+      return false;
+    }
+    std::cout << "Session: condition " << session->num_done() + 1 << " / " << session->plan().size() << " (alpha ID = "
+              << next.alpha_id << ", trajectory ID = " << next.traj_id << ")\n" << std::endl;
+    if (next.alpha_id != alpha_id || next.traj_id != traj_id) {
+      std::cout << "This node was started with alpha ID = " << alpha_id << ", trajectory ID = " << traj_id
+                << ", shutting down now !!! Restart both nodes with the planned condition (plus your other parameters):\n"
+                << "   ros2 run cpp_pubsub real_controller --ros-args -p part_id:=" << part_id << " -p alpha_id:=" << next.alpha_id
+                << " -p traj_id:=" << next.traj_id << "\n"
+                << "   ros2 run cpp_pubsub marker_publisher --ros-args -p part_id:=" << part_id << " -p alpha_id:=" << next.alpha_id
+                << " -p traj_id:=" << next.traj_id << "\n" << std::endl;
+      return false;
+    }
+    session_plan_active = true;
+    return true;
+  }
+
+  // control thread, while recording: a dead position_talker (e.g. a device error) freezes the human input
+  void check_falcon_stream()
+  {
+    if (falcon_lost) return;
+    int64_t last = last_falcon_ns.load(std::memory_order_relaxed);
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - control_epoch).count();
+    if (last < 0 || now - last > falcon_timeout_ns) {
+      falcon_lost = true;
+      std::cout << "--------\nNo Falcon samples, this attempt will not count as done\n---------" << std::endl;
+    }
+  }
+
+  // control thread, after a live parameter update: the attempt follows a condition change before the recording,
+  // a change once it started mixes two conditions and the attempt will not count as done
+  void update_session_condition()
+  {
+    SessionCondition c {free_drive == 1 ? 5 : alpha_id, traj_id};
+    if (c.alpha_id == session->attempt_condition().alpha_id && c.traj_id == session->attempt_condition().traj_id) return;
+    if (count < max_smoothing_count) session->set_attempt_condition(c);
+    else session_condition_changed = true;
+  }
+
+  // called once at the end of the recording
+  void finish_session()
+  {
+    if (falcon_lost || session_condition_changed) session->abort();
+    else session->complete(tracking_score.score());
+    session_saver.request();
+  }
+
+  /////////////////////////////// tracking score functions ///////////////////////////////
+  void update_tracking_score()
+  {
+    double ref[3];
+    for (int i=0; i<3; i++) ref[i] = origin.at(i) + ref_offset.at(i);
+    tracking_score.add_sample(tcp_pos.data(), ref);
+    if (tracking_score.num_samples() % (control_freq / score_pub_frequency) == 0) publish_tracking_score(false);
+  }
+
+  void publish_tracking_score(bool final)
+  {
+    double * d = score_msg.data.data();
+    d[0] = tracking_score.score();
+    d[1] = tracking_score.recent_score();
+    d[2] = tracking_score.rms();
+    d[3] = tracking_score.recent_rms();
+    d[4] = tracking_score.max_error();
+    d[5] = (double) (count - max_smoothing_count) / control_freq;
+    d[6] = final ? 1.0 : 0.0;
+    d[7] = count;
+    d[8] = monotonic_seconds(std::chrono::steady_clock::now());
+    score_pub_->publish(score_msg);
+  }
+
+  /////////////////////////////// alpha adaptation functions ///////////////////////////////
+  void update_alpha_adaptation()
+  {
+    double human[3] {human_offset.at(0), human_offset.at(1), human_offset.at(2)};
+    double ref[3] {ref_offset.at(0), ref_offset.at(1), ref_offset.at(2)};
+    double robot[3] {robot_offset.at(0), robot_offset.at(1), robot_offset.at(2)};
+    adaptation.add_sample(human, ref, robot);
+
+    // online mode: adapt once per second from the last second of samples
+    if (adapt_alpha == 2 && adaptation.num_samples() == control_freq) {
+      double alpha[3] {iax, iay, iaz};
+      adaptation.update(alpha, adapt_settings);
+      alpha_ramp_from[0] = ax; alpha_ramp_from[1] = ay; alpha_ramp_from[2] = az;
+      iax = alpha[0];
+      iay = alpha[1];
+      iaz = alpha[2];
+      alpha_ramp_count = 0;
+      adaptation.reset();
+    }
+  }
+
+  // control thread, once per tick while a ramp runs: same cubic profile as a live configuration change
+  void step_alpha_ramp()
+  {
+    alpha_ramp_count++;
+    double w = config_fade.at(alpha_ramp_count);
+    ax = (1-w) * alpha_ramp_from[0] + w * iax;
+    ay = (1-w) * alpha_ramp_from[1] + w * iay;
+    az = (1-w) * alpha_ramp_from[2] + w * iaz;
+    if (alpha_ramp_count >= config_fade.num_ticks()) alpha_ramp_count = -1;
+  }
+
+  // called once at the end of the recording, updates (between-trial mode) and stores the participant's alphas
+  void finish_alpha_adaptation()
+  {
+    double alpha[3] {iax, iay, iaz};
+    if (adapt_alpha == 1) {
+      for (int i=0; i<3; i++) {
+        std::cout << "Axis " << i << ": tracking error = " << adaptation.rms_track(i)
+                  << " [m], disagreement = " << adaptation.rms_disagree(i) << " [m]" << std::endl;
+      }
+      adaptation.update(alpha, adapt_settings);
+    }
+    adaptation.reset();
+
+    ParticipantStore store(participant_dir, part_id);
+    store.load();
+    store.set("alpha", {alpha[0], alpha[1], alpha[2]});
+    if (store.save()) {
+      std::cout << "Adapted alphas {" << alpha[0] << ", " << alpha[1] << ", " << alpha[2] << "} saved to " << store.path() << std::endl;
+    } else {
+      std::cerr << "Unable to save the adapted alphas to " << store.path() << std::endl;
+    }
+  }
+
+  /////////////////////////////// free-drive calibration functions ///////////////////////////////
+  void prepare_calibration()
+  {
+    std::vector<ReferenceTrajectory> references(6);
+    for (int id=0; id<6; id++) {
+      SineSumParams tp;
+      get_sine_sum_params(id, tp);
+      tp.use_depth = use_depth;
+      references.at(id).build([&tp](double t, double * xyz) { sine_sum_offset(tp, t, xyz); }, max_recording_count, arc_length == 1);
+    }
+    reference_demands(references, traj_duration, calibration_extent, calibration_speed);
+    calibration.configure(calibration_settings, control_freq);
+  }
+
+  void load_calibration()
+  {
+    ParticipantStore store(participant_dir, part_id);
+    std::vector<double> gains, center;
+    if (!store.load() || !store.get("mapping_gains", gains) || !store.get("centering", center) || gains.size() != 3 || center.size() != 3) return;
+    for (int i=0; i<3; i++) {
+      mapping_settings.axis_gains[i] = gains.at(i);
+      mapping_settings.device_center[i] = center.at(i);
+    }
+    mapping_settings.axis_gains_set = true;
+    if (mapping_settings.mode == MappingMode::uniform) mapping_settings.mode = MappingMode::per_axis;
+    std::cout << "Free-drive calibration loaded from " << store.path() << ": gains = {" << gains.at(0) << ", " << gains.at(1) << ", "
+              << gains.at(2) << "}, centering = {" << center.at(0) << ", " << center.at(1) << ", " << center.at(2) << "} [cm]\n" << std::endl;
+  }
+
+  // called once at the end of a free-drive recording
+  void finish_calibration()
+  {
+    double default_gains[3];
+    for (int i=0; i<3; i++) {
+      bool uniform = mapping_settings.mode == MappingMode::uniform || !mapping_settings.axis_gains_set;
+      default_gains[i] = uniform ? mapping_ratio : mapping_settings.axis_gains[i];
+    }
+    CalibrationResult r = calibration.compute(calibration_extent, calibration_speed, default_gains);
+    for (int i=0; i<3; i++) {
+      std::cout << "Axis " << i << ": comfortable range = " << r.range[i] << " [cm] around " << r.center[i] << " [cm], speed = "
+                << r.speed[i] << " [cm/s] -> gain = " << r.gains[i] << std::endl;
+    }
+    if (!r.valid) {
+      std::cerr << "Free-drive calibration rejected (" << calibration.num_samples() << " samples, too short or too little motion), nothing saved" << std::endl;
+      return;
+    }
+
+    ParticipantStore store(participant_dir, part_id);
+    store.load();
+    store.set("mapping_gains", {r.gains[0], r.gains[1], r.gains[2]});
+    store.set("centering", {r.center[0], r.center[1], r.center[2]});
+    store.set("device_range", {r.range[0], r.range[1], r.range[2]});
+    store.set("device_speed", {r.speed[0], r.speed[1], r.speed[2]});
+    if (store.save()) std::cout << "Free-drive calibration saved to " << store.path() << std::endl;
+    else std::cerr << "Unable to save the free-drive calibration to " << store.path() << std::endl;
+  }
+
+  /////////////////////////////// MPC shared control function ///////////////////////////////
+  void compute_mpc_target(int traj_count)
+  {
+    const double alphas[3] {ax, ay, az};
+    auto start = std::chrono::steady_clock::now();
+
+    // the joint position / velocity limits, linearised around the current joint values, as per-axis box and step limits
+    double x0[3], lo[3], hi[3], step[3];
+    for (int i=0; i<3; i++) x0[i] = tcp_pos.at(i) - origin.at(i);   // last commanded offset
+    for (unsigned int j=0; j<n_joints; j++) mpc_q(j) = curr_joint_vals.at(j);
+    for (int i=0; i<3; i++) {
+      KDL::Vector unit(i == 0, i == 1, i == 2);
+      mpc_vel_solver->CartToJnt(mpc_q, KDL::Twist(unit, KDL::Vector::Zero()), mpc_qdot);
+      for (unsigned int j=0; j<n_joints; j++) mpc_dq_dx[i][j] = mpc_qdot(j);
+    }
+    joint_limit_bounds(mpc_dq_dx, curr_joint_vals.data(), lower_joint_limits.data(), upper_joint_limits.data(), max_joint_velocities.data(),
+                       1.0 / control_freq, x0, mpc_settings, lo, hi, step);
+
+    int iters = 0;
+    bool converged = true;
+    for (int i=0; i<3; i++) {
+      if (!mpc_initialized) mpc_qp[i].reset(x0[i]);
+      for (int k=0; k<mpc_horizon; k++) mpc_ref[k] = robot_target(i, traj_count + k);
+
+      mpc_qp[i].shift();
+      iters = std::max(iters, mpc_qp[i].solve(x0[i], human_offset.at(i), mpc_ref, alphas[i], lo[i], hi[i], step[i], mpc_settings));
+      converged = converged && mpc_qp[i].converged();
+      tcp_pos.at(i) = origin.at(i) + mpc_qp[i].first_move(x0[i], lo[i], hi[i], step[i]);
+    }
+    mpc_initialized = true;
+
+    auto finish = std::chrono::steady_clock::now();
+    mpc_stats.add(std::chrono::duration<double, std::micro>(finish - start).count(), iters, converged);
+
+    if (mpc_stats.n == control_freq) {
+      auto stats_msg = std_msgs::msg::Float64MultiArray();
+      stats_msg.data = {mpc_stats.mean_us(), mpc_stats.max_us, mpc_stats.mean_iter(), (double) mpc_stats.max_iter,
+                        (double) mpc_stats.not_converged, (double) mpc_stats.n};
+      mpc_stats_pub_->publish(stats_msg);
+      mpc_stats.clear();
+    }
   }
 
   ///////////////////////////////////// FUNCTION TO READ NOISE CSV AND INTERPOLATE /////////////////////////////////////
-  void generate_noise_vector(const std::string filename) {
+  std::vector<double> generate_noise_vector(const std::string filename, KernelType kernel) const {
 
     std::cout << "Noise filename = " << filename << std::endl;
 
@@ -505,9 +1630,14 @@ private:
     // }
     // std::cout << std::endl;
 
-    // interpolate (linear / cosine)
-    robot_noise_vector = linear_interpolate_vec(raw_data, num_interp);
-    std::cout << "Success! Length of new noise vector = " << robot_noise_vector.size() << std::endl;
+    // upsample 50x (linear, cosine, Catmull-Rom, monotone Hermite, windowed sinc) straight into the output
+    if (raw_data.empty()) return {};
+    Upsampler upsampler;
+    upsampler.configure(kernel, num_interp + 1);
+    std::vector<double> noise_vector(upsampled_size(raw_data.size(), num_interp + 1));
+    upsampler.run(raw_data.data(), raw_data.size(), noise_vector.data());
+    std::cout << "Success! Length of new noise vector = " << noise_vector.size() << std::endl;
+    return noise_vector;
   }
 
   ///////////////////////////////////// FUNCTION TO PRINT PARAMETERS /////////////////////////////////////
@@ -520,6 +1650,21 @@ private:
     std::cout << "Participant ID = " << part_id << "\n" << std::endl;
     std::cout << "Alpha ID = " << alpha_id << "\n" << std::endl;
     std::cout << "Trajectory ID = " << traj_id << "\n" << std::endl;
+    std::cout << "Blend type = " << blend_type << "\n" << std::endl;
+    std::cout << "Arc-length reference = " << arc_length << "\n" << std::endl;
+    std::cout << "Mapping mode = " << static_cast<int>(mapping_settings.mode) << ", axis gains = {"
+              << mapping_settings.axis_gains[0] << ", " << mapping_settings.axis_gains[1] << ", " << mapping_settings.axis_gains[2] << "}\n" << std::endl;
+    std::cout << "Control mode = " << control_mode << "\n" << std::endl;
+    std::cout << "Alpha adaptation = " << adapt_alpha << "\n" << std::endl;
+    std::cout << "Loop mode = " << loop_mode << ", tick policy = " << tick_policy << "\n" << std::endl;
+    std::cout << "Phase trace window = " << trace_window << " [s]\n" << std::endl;
+    std::cout << "Noise mode = " << live_params.noise_mode << " (0 = csv file on z, 1 = spectral), noise kernel = " << live_params.noise_kernel << "\n" << std::endl;
+    std::cout << "Origin = {" << origin.at(0) << ", " << origin.at(1) << ", " << origin.at(2) << "}\n" << std::endl;
+    std::cout << "Use calibration = " << use_calibration << ", device centering = {" << mapping_settings.device_center[0] << ", "
+              << mapping_settings.device_center[1] << ", " << mapping_settings.device_center[2] << "} [cm]\n" << std::endl;
+    std::cout << "Trial log = " << write_trial_log << ", session checkpoint = " << use_session << "\n" << std::endl;
+    std::cout << "Tracking score: 50 points at " << score_settings.half_score_error << " [m RMS]\n" << std::endl;
+    std::cout << "Clutch = " << indexing_settings.clutch << ", rate zone = " << indexing_settings.rate_zone << " [cm]\n" << std::endl;
     for (unsigned int i=0; i<10; i++) std::cout << "\n";
   }
 
@@ -538,9 +1683,21 @@ private:
 
   rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr countdown_pub_;
 
+  rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr mpc_stats_pub_;
+
+  rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr timing_pub_;
+  rclcpp::Subscription<std_msgs::msg::Bool>::SharedPtr dump_trace_sub_;
+  rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr perturbation_pub_;
+  rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr measured_tcp_pub_;
+  rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr score_pub_;
+  std_msgs::msg::Float64MultiArray perturbation_msg;
+  rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr param_callback_handle_;
+
   rclcpp::Subscription<sensor_msgs::msg::JointState>::SharedPtr joint_vals_sub_;
 
   rclcpp::Subscription<tutorial_interfaces::msg::Falconpos>::SharedPtr falcon_pos_sub_;
+
+  rclcpp::Subscription<std_msgs::msg::Bool>::SharedPtr falcon_button_sub_;
   
 };
 
@@ -621,44 +1778,6 @@ void readCSV(const std::string& filename, std::vector<double>& dataArray) {
     }
 }
 
-// Function to linearly interpolate between two numbers for a given mu
-double linearInterpolate(double y1, double y2, double mu) { return (y2 - y1) * mu + y1; }
-
-// Function to cosine interpolate between two numbers for a given mu
-double cosineInterpolate(double y1, double y2, double mu) {
-    double angle = mu * M_PI;
-    double mu2 = (1.0 - std::cos(angle)) * 0.5;
-    double res = linearInterpolate(y1, y2, mu2);
-    return res;
-}
-
-// Function to linearly interpolate a vector and return a new vector
-std::vector<double> linear_interpolate_vec(std::vector<double> old_vec, int num_interp) {
-    int num_old_points = old_vec.size();
-    std::vector<double> new_vec = {old_vec.at(0)};
-    for (int i=0; i<num_old_points-1; i++) {
-        for (int j=1; j<num_interp+2; j++) {
-            double mu = (double)j / (double)(num_interp+1);
-            double lin_x = linearInterpolate(old_vec.at(i), old_vec.at(i+1), mu);
-            new_vec.push_back(lin_x);
-        }
-    }
-    return new_vec;
-}
-
-// Function to cosine interpolate a vector and return a new vector
-std::vector<double> cosine_interpolate_vec(std::vector<double> old_vec, int num_interp) {
-    int num_old_points = old_vec.size();
-    std::vector<double> new_vec = {old_vec.at(0)};
-    for (int i=0; i<num_old_points-1; i++) {
-        for (int j=1; j<num_interp+2; j++) {
-            double mu = (double)j / (double)(num_interp+1);
-            double lin_x = cosineInterpolate(old_vec.at(i), old_vec.at(i+1), mu);
-            new_vec.push_back(lin_x);
-        }
-    }
-    return new_vec;
-}
 
 
 ///////////////// other helper functions /////////////////
@@ -707,7 +1826,14 @@ int main(int argc, char * argv[])
 
   std::shared_ptr<RealController> michael = std::make_shared<RealController>();
 
-  rclcpp::spin(michael);
+  // the constructor shuts down early (session complete, no trial configuration) before the subscriptions exist
+  if (rclcpp::ok()) {
+    if (michael->uses_wait_set()) {
+      michael->run_wait_set_loop();
+    } else {
+      rclcpp::spin(michael);
+    }
+  }
 
   rclcpp::shutdown();
   return 0;
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <cmath>
+#include <memory>
+#include <string>
+
+#include "rclcpp/rclcpp.hpp"
+#include "std_msgs/msg/bool.hpp"
+#include "std_msgs/msg/float64.hpp"
+#include "std_msgs/msg/float64_multi_array.hpp"
+#include "sensor_msgs/msg/joint_state.hpp"
+#include "visualization_msgs/msg/marker.hpp"
+#include "visualization_msgs/msg/marker_array.hpp"
+
+#include "tutorial_interfaces/msg/pos_info.hpp"
+
+#include "cpp_pubsub/trial_log.hpp"
+
+using namespace std::chrono_literals;
+
+
+/////////////////// replay of a recorded trial log ///////////////////
+// Streams a trial log (written by real_controller, see trial_log.hpp) into the same topics the live trial uses,
+// so marker_publisher and RViz show it as if it was running:
+//   tcp_position (while the record flag was set), countdown, joint states and the replay_markers
+// Controls (any time):
+//   replay/speed  Float64  playback speed, clamped to [0.1, 10]
+//   replay/seek   Float64  jump to this many seconds after the start of the log
+//   replay/pause  Bool     true = pause, false = resume
+// The log is memory-mapped, a seek is a binary search over the records.
+class TrialReplay : public rclcpp::Node
+{
+  public:
+
+    // parameters name list
+    std::vector<std::string> param_names = {"log_file", "speed", "start_time", "loop", "joint_states_topic"};
+    std::string log_file;
+    double speed {1.0};
+    double start_time {0.0};   // [s] after the start of the log
+    int loop {0};
+    std::string joint_states_topic {"joint_states"};
+
+    const double min_speed = 0.1;
+    const double max_speed = 10.0;
+
+    TrialLogReader reader;
+
+    // playback position in [s] since the first record, advanced by the wall clock times the speed
+    double play_time {0.0};
+    bool paused = false;
+    std::chrono::steady_clock::time_point last_frame_time;
+    long last_index = -1;
+    long last_second = -1;
+
+    std::vector<std::string> joint_names {"panda_joint1", "panda_joint2", "panda_joint3", "panda_joint4",
+                                          "panda_joint5", "panda_joint6", "panda_joint7"};
+
+
+    TrialReplay()
+    : Node("trial_replay")
+    {
+      // parameter stuff
+      this->declare_parameter(param_names.at(0), std::string(""));
+      this->declare_parameter(param_names.at(1), 1.0);
+      this->declare_parameter(param_names.at(2), 0.0);
+      this->declare_parameter(param_names.at(3), 0);
+      this->declare_parameter(param_names.at(4), joint_states_topic);
+
+      std::vector<rclcpp::Parameter> params = this->get_parameters(param_names);
+      log_file = params.at(0).value_to_string();
+      speed = std::clamp(std::stod(params.at(1).value_to_string().c_str()), min_speed, max_speed);
+      start_time = std::stod(params.at(2).value_to_string().c_str());
+      loop = std::stoi(params.at(3).value_to_string().c_str());
+      joint_states_topic = params.at(4).value_to_string();
+
+      if (!reader.open(log_file) || reader.size() == 0) {
+        std::cout << "Could not open the trial log '" << log_file << "' (missing, empty or not a version "
+                  << trial_log_version << " log), shutting down now !!!" << std::endl;
+        rclcpp::shutdown();
+        return;
+      }
+      print_params();
+      seek(start_time);
+
+      // publishers, same topics as the live trial
+      tcp_pos_pub_ = this->create_publisher<tutorial_interfaces::msg::PosInfo>("tcp_position", 10);
+      countdown_pub_ = this->create_publisher<std_msgs::msg::Float64>("countdown", 10);
+      joint_states_pub_ = this->create_publisher<sensor_msgs::msg::JointState>(joint_states_topic, 10);
+      marker_pub_ = this->create_publisher<visualization_msgs::msg::MarkerArray>("replay_markers", 10);
+
+      // {log time [s], time from start [s], speed, paused, progress [0-1]}, every frame
+      status_pub_ = this->create_publisher<std_msgs::msg::Float64MultiArray>("replay/status", 10);
+
+      speed_sub_ = this->create_subscription<std_msgs::msg::Float64>(
+      "replay/speed", 10, std::bind(&TrialReplay::speed_callback, this, std::placeholders::_1));
+      seek_sub_ = this->create_subscription<std_msgs::msg::Float64>(
+      "replay/seek", 10, std::bind(&TrialReplay::seek_callback, this, std::placeholders::_1));
+      pause_sub_ = this->create_subscription<std_msgs::msg::Bool>(
+      "replay/pause", 10, std::bind(&TrialReplay::pause_callback, this, std::placeholders::_1));
+
+      // one frame every 20 ms (50 Hz, same as the marker publisher) regardless of the speed
+      last_frame_time = std::chrono::steady_clock::now();
+      frame_timer_ = this->create_wall_timer(20ms, std::bind(&TrialReplay::frame_callback, this));
+    }
+
+
+  private:
+
+    double duration() const { return reader.end_time() - reader.start_time(); }
+
+    void seek(double t)
+    {
+      play_time = std::clamp(t, 0.0, duration());
+      last_second = -1;   // re-publish the countdown at the new position
+    }
+
+    ///////////////////////////////////// PLAYBACK /////////////////////////////////////
+    void frame_callback()
+    {
+      auto now = std::chrono::steady_clock::now();
+      double dt = std::chrono::duration<double>(now - last_frame_time).count();
+      last_frame_time = now;
+      if (!paused) play_time += dt * speed;
+
+      if (play_time > duration()) {
+        if (loop == 1) seek(0.0);
+        else { play_time = duration(); paused = true; }
+      }
+
+      long index = reader.index_at(reader.start_time() + play_time);
+      const TrialLogRecord & r = reader.at(index);
+
+      // joint states every frame, so the robot model also follows while paused / scrubbing
+      auto joint_msg = sensor_msgs::msg::JointState();
+      joint_msg.header.stamp = this->now();
+      joint_msg.name = joint_names;
+      joint_msg.position.assign(r.joints_measured, r.joints_measured + 7);
+      joint_states_pub_->publish(joint_msg);
+
+      // tcp position only while the record flag was set, like the live trial
+      if (index != last_index && (r.flags & trial_log_record_flag)) {
+        auto pos_msg = tutorial_interfaces::msg::PosInfo();
+        pos_msg.ref_position = {r.ref[0], r.ref[1], r.ref[2]};
+        pos_msg.human_position = {r.human[0], r.human[1], r.human[2]};
+        pos_msg.robot_position = {r.robot[0], r.robot[1], r.robot[2]};
+        pos_msg.tcp_position = {r.tcp[0], r.tcp[1], r.tcp[2]};
+        pos_msg.time_from_start = r.time_from_start;
+        tcp_pos_pub_->publish(pos_msg);
+      }
+
+      // countdown whenever the whole controller second changes (also backwards after a seek)
+      long second = r.tick / reader.header().control_freq;
+      if (second != last_second) {
+        auto count_msg = std_msgs::msg::Float64();
+        count_msg.data = second;
+        countdown_pub_->publish(count_msg);
+        last_second = second;
+      }
+      last_index = index;
+
+      publish_markers(r);
+
+      auto status_msg = std_msgs::msg::Float64MultiArray();
+      status_msg.data = {play_time, r.time_from_start, speed, paused ? 1.0 : 0.0, duration() > 0.0 ? play_time / duration() : 1.0};
+      status_pub_->publish(status_msg);
+    }
+
+    // human target and commanded TCP of the logged tick, plus the replay state
+    void publish_markers(const TrialLogRecord & r)
+    {
+      auto marker_array_msg = visualization_msgs::msg::MarkerArray();
+
+      auto human = visualization_msgs::msg::Marker();
+      human.header.frame_id = "/panda_link0";
+      human.header.stamp = this->now();
+      human.ns = "trial_replay";
+      human.action = visualization_msgs::msg::Marker::ADD;
+      human.id = 0;
+      human.type = visualization_msgs::msg::Marker::SPHERE;
+      human.scale.x = 0.015;
+      human.scale.y = 0.015;
+      human.scale.z = 0.015;
+      human.color.b = 1.0;   // human target is blue
+      human.color.a = 0.8;
+      human.pose.position.x = r.human[0];
+      human.pose.position.y = r.human[1];
+      human.pose.position.z = r.human[2];
+      marker_array_msg.markers.push_back(human);
+
+      auto tcp = human;
+      tcp.id = 1;
+      tcp.scale.x = 0.01;
+      tcp.scale.y = 0.01;
+      tcp.scale.z = 0.01;
+      tcp.color.b = 0.0;
+      tcp.color.r = 1.0;   // commanded tcp is red
+      tcp.pose.position.x = r.tcp[0];
+      tcp.pose.position.y = r.tcp[1];
+      tcp.pose.position.z = r.tcp[2];
+      marker_array_msg.markers.push_back(tcp);
+
+      auto text = visualization_msgs::msg::Marker();
+      text.header = human.header;
+      text.ns = "trial_replay";
+      text.action = visualization_msgs::msg::Marker::ADD;
+      text.id = 2;
+      text.type = visualization_msgs::msg::Marker::TEXT_VIEW_FACING;
+      text.scale.z = 0.05;
+      text.color.r = 1.0;
+      text.color.g = 1.0;
+      text.color.b = 1.0;
+      text.color.a = 1.0;
+      char buffer[64];
+      std::snprintf(buffer, sizeof(buffer), "replay %.1f / %.1f s  x%.1f%s", play_time, duration(), speed, paused ? "  (paused)" : "");
+      text.text = buffer;
+      text.pose.position.x = 0.3;
+      text.pose.position.y = 0.0;
+      text.pose.position.z = 0.8;
+      marker_array_msg.markers.push_back(text);
+
+      marker_pub_->publish(marker_array_msg);
+    }
+
+    void speed_callback(const std_msgs::msg::Float64 & msg) { speed = std::clamp(msg.data, min_speed, max_speed); }
+
+    void seek_callback(const std_msgs::msg::Float64 & msg)
+    {
+      seek(msg.data);
+      if (play_time < duration()) paused = false;
+    }
+
+    void pause_callback(const std_msgs::msg::Bool & msg) { paused = msg.data; }
+
+    void print_params() {
+      const TrialLogHeader & h = reader.header();
+      for (unsigned int i=0; i<10; i++) std::cout << "\n";
+      std::cout << "\n\nThe current parameters [trial_replay] are as follows:\n" << std::endl;
+      std::cout << "Log file = " << log_file << "\n" << std::endl;
+      std::cout << "Records = " << reader.size() << " (" << duration() << " [s] at " << h.control_freq << " Hz)\n" << std::endl;
+      std::cout << "Participant ID = " << h.part_id << ", alpha ID = " << h.alpha_id << ", trajectory ID = " << h.traj_id
+                << ", use depth = " << h.use_depth << ", arc length = " << h.arc_length << "\n" << std::endl;
+      std::cout << "Speed = " << speed << ", start time = " << start_time << " [s], loop = " << loop << "\n" << std::endl;
+      for (unsigned int i=0; i<10; i++) std::cout << "\n";
+    }
+
+    rclcpp::TimerBase::SharedPtr frame_timer_;
+    rclcpp::Publisher<tutorial_interfaces::msg::PosInfo>::SharedPtr tcp_pos_pub_;
+    rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr countdown_pub_;
+    rclcpp::Publisher<sensor_msgs::msg::JointState>::SharedPtr joint_states_pub_;
+    rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr marker_pub_;
+    rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr status_pub_;
+
+    rclcpp::Subscription<std_msgs::msg::Float64>::SharedPtr speed_sub_;
+    rclcpp::Subscription<std_msgs::msg::Float64>::SharedPtr seek_sub_;
+    rclcpp::Subscription<std_msgs::msg::Bool>::SharedPtr pause_sub_;
+
+};
+
+
+/////////////////////////// THE MAIN FUNCTION ///////////////////////////
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  auto node = std::make_shared<TrialReplay>();
+  if (rclcpp::ok()) rclcpp::spin(node);
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+
+# Comparative report of the transport benchmark results (one csv line per ping run, see run_suite.sh).
+#   ros2 run transport_bench bench_report.py results.csv
+
+import sys
+import csv
+from collections import defaultdict
+
+
+CONTROL_PERIOD_US = 2000.0   # real_controller runs at 500 Hz
+
+
+
+##############################################################################
+def load(path):
+    with open(path) as f:
+        return list(csv.DictReader(f))
+
+
+##############################################################################
+def rate_name(rate):
+    return "max" if int(rate) == 0 else rate + " Hz"
+
+
+##############################################################################
+def print_latency_tables(rows):
+    # one table per message type, one row per (rate, qos), one column group per transport
+    transports = sorted({r["label"] for r in rows})
+    by_type = defaultdict(list)
+    for r in rows: by_type[r["msg_type"]].append(r)
+
+    for msg_type, type_rows in by_type.items():
+        print("\n### %s (%s bytes)\n" % (msg_type, type_rows[0]["bytes"]))
+        header = "| rate | qos |" + "".join(" %s p50 / p99 / max [us] | %s loss |" % (t, t) for t in transports)
+        print(header)
+        print("|" + "---|" * (2 + 2 * len(transports)))
+
+        cells = defaultdict(dict)
+        for r in type_rows:
+            qos = ("reliable" if r["reliable"] == "1" else "best effort") + " d" + r["depth"]
+            cells[(int(r["rate"]) or 10**9, rate_name(r["rate"]), qos)][r["label"]] = r
+        for key in sorted(cells):
+            line = "| %s | %s |" % (key[1], key[2])
+            for t in transports:
+                r = cells[key].get(t)
+                if r is None:
+                    line += " - | - |"
+                    continue
+                line += " %.0f / %.0f / %.0f | %.2f %% |" % (float(r["p50_us"]), float(r["p99_us"]), float(r["max_us"]), float(r["loss_pct"]))
+            print(line)
+
+
+##############################################################################
+def print_recommendation(rows):
+    # best transport per message type at the control rate: lowest p99 round trip without loss
+    print("\n### Recommendation at the 500 Hz control rate\n")
+    for msg_type in sorted({r["msg_type"] for r in rows}):
+        candidates = [r for r in rows if r["msg_type"] == msg_type and r["rate"] == "500" and float(r["loss_pct"]) == 0.0]
+        if not candidates:
+            print("- %s: no loss-free run at 500 Hz" % msg_type)
+            continue
+        best = min(candidates, key=lambda r: float(r["p99_us"]))
+        one_way = float(best["p99_us"]) / 2
+        print("- %s: %s (%s, depth %s), p99 one-way ~%.0f us = %.1f %% of a control period; max throughput %s"
+              % (msg_type, best["label"], "reliable" if best["reliable"] == "1" else "best effort", best["depth"],
+                 one_way, 100 * one_way / CONTROL_PERIOD_US, max_throughput(rows, msg_type, best["label"])))
+
+
+##############################################################################
+def max_throughput(rows, msg_type, label):
+    flood = [float(r["throughput_hz"]) for r in rows if r["msg_type"] == msg_type and r["label"] == label and r["rate"] == "0"]
+    return "%.0f round trips/s" % max(flood) if flood else "not measured"
+
+
+
+##############################################################################
+def main():
+    if len(sys.argv) != 2:
+        print("usage: bench_report.py <results.csv>")
+        sys.exit(1)
+    rows = load(sys.argv[1])
+    if not rows:
+        print("No results in %s" % sys.argv[1])
+        sys.exit(1)
+    print_latency_tables(rows)
+    print_recommendation(rows)
+    print()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,49 @@
+#!/bin/bash
+# Runs the transport benchmark over message types x rates x QoS x transports and prints the comparison.
+#   ros2 run transport_bench run_suite.sh [results.csv] [duration]
+# Transports:
+#   intra  -> ping and pong in one process with intra-process comms
+#   udp    -> two processes, Fast DDS restricted to UDPv4 loopback
+#   shm    -> two processes, Fast DDS restricted to shared memory
+# Run it on the control PC with the robot and the Falcon nodes stopped.
+
+RESULTS=${1:-transport_bench_results.csv}     # relative to the working directory
+DURATION=${2:-10.0}
+CONFIG_DIR=$(ros2 pkg prefix transport_bench)/share/transport_bench/config
+
+MSG_TYPES="falconpos posinfo joint_state marker_array"
+RATES="500 1000 2000 5000 10000 0"     # 0 = as fast as possible (max throughput)
+QOS_SETTINGS="1:10 0:1"                 # reliable:depth
+
+mkdir -p "$(dirname "$RESULTS")"
+export RMW_IMPLEMENTATION=rmw_fastrtps_cpp
+
+run_one() {
+  local transport=$1 msg_type=$2 rate=$3 reliable=$4 depth=$5
+  local args="-p msg_type:=$msg_type -p rate:=$rate -p reliable:=$reliable -p depth:=$depth -p duration:=$DURATION -p label:=$transport -p results_file:=$RESULTS"
+
+  if [ "$transport" == "intra" ]; then
+    unset FASTRTPS_DEFAULT_PROFILES_FILE
+    ros2 run transport_bench transport_bench intra --ros-args $args
+    return
+  fi
+
+  export FASTRTPS_DEFAULT_PROFILES_FILE=$CONFIG_DIR/fastdds_$transport.xml
+  ros2 run transport_bench transport_bench pong --ros-args $args &
+  local pong_pid=$!
+  ros2 run transport_bench transport_bench ping --ros-args $args
+  kill -INT $pong_pid 2>/dev/null
+  wait $pong_pid 2>/dev/null
+}
+
+for transport in intra udp shm; do
+  for msg_type in $MSG_TYPES; do
+    for rate in $RATES; do
+      for qos in $QOS_SETTINGS; do
+        run_one $transport $msg_type $rate ${qos%%:*} ${qos##*:}
+      done
+    done
+  done
+done
+
+ros2 run transport_bench bench_report.py "$RESULTS"
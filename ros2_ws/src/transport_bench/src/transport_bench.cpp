@@ -0,0 +1,314 @@
+#include "rclcpp/rclcpp.hpp"
+#include "sensor_msgs/msg/joint_state.hpp"
+#include "visualization_msgs/msg/marker_array.hpp"
+
+#include "tutorial_interfaces/msg/falconpos.hpp"
+#include "tutorial_interfaces/msg/pos_info.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+// Round-trip latency / throughput benchmark for the message types of the teleoperation pipeline.
+//   transport_bench intra --ros-args -p msg_type:=falconpos -p rate:=1000    (ping and pong in one process, intra-process comms)
+//   transport_bench pong  --ros-args -p msg_type:=falconpos                  (echo side of an inter-process run)
+//   transport_bench ping  --ros-args -p msg_type:=falconpos -p rate:=1000    (sending / measuring side)
+// The transport between processes (UDP, shared memory, ...) is chosen by the RMW configuration, see scripts/run_suite.sh.
+// Every ping run appends one line to results_file, scripts/bench_report.py turns that file into the comparison.
+
+const unsigned int seq_ring_size = 1 << 16;
+
+
+///////////////////////////////////// MESSAGE TRAITS /////////////////////////////////////
+// fill a message of realistic size and carry the sequence number in a field the pipeline already has
+template<typename MsgT> struct BenchTraits;
+
+template<> struct BenchTraits<tutorial_interfaces::msg::Falconpos>
+{
+  static void init(tutorial_interfaces::msg::Falconpos &, int) {}
+  static void set_seq(tutorial_interfaces::msg::Falconpos & msg, uint64_t seq) { msg.x = (double) seq; }
+  static uint64_t get_seq(const tutorial_interfaces::msg::Falconpos & msg) { return (uint64_t) msg.x; }
+};
+
+template<> struct BenchTraits<tutorial_interfaces::msg::PosInfo>
+{
+  static void init(tutorial_interfaces::msg::PosInfo &, int) {}
+  static void set_seq(tutorial_interfaces::msg::PosInfo & msg, uint64_t seq) { msg.time_from_start = (double) seq; }
+  static uint64_t get_seq(const tutorial_interfaces::msg::PosInfo & msg) { return (uint64_t) msg.time_from_start; }
+};
+
+template<> struct BenchTraits<sensor_msgs::msg::JointState>
+{
+  // same layout as franka/joint_states
+  static void init(sensor_msgs::msg::JointState & msg, int)
+  {
+    for (int i=1; i<=7; i++) msg.name.push_back("panda_joint" + std::to_string(i));
+    msg.position.assign(7, 0.0);
+    msg.velocity.assign(7, 0.0);
+    msg.effort.assign(7, 0.0);
+  }
+  static void set_seq(sensor_msgs::msg::JointState & msg, uint64_t seq) { msg.position.at(0) = (double) seq; }
+  static uint64_t get_seq(const sensor_msgs::msg::JointState & msg) { return msg.position.empty() ? 0 : (uint64_t) msg.position.at(0); }
+};
+
+template<> struct BenchTraits<visualization_msgs::msg::MarkerArray>
+{
+  // payload = number of line-strip markers of 200 points each (the marker_publisher trajectory marker)
+  static void init(visualization_msgs::msg::MarkerArray & msg, int payload)
+  {
+    msg.markers.resize(std::max(payload, 1));
+    for (auto & marker : msg.markers) {
+      marker.header.frame_id = "panda_link0";
+      marker.type = visualization_msgs::msg::Marker::LINE_STRIP;
+      marker.points.resize(200);
+    }
+  }
+  static void set_seq(visualization_msgs::msg::MarkerArray & msg, uint64_t seq) { msg.markers.at(0).id = (int) seq; }
+  static uint64_t get_seq(const visualization_msgs::msg::MarkerArray & msg) { return msg.markers.empty() ? 0 : (uint64_t) msg.markers.at(0).id; }
+};
+
+
+///////////////////////////////////// QOS /////////////////////////////////////
+rclcpp::QoS bench_qos(int reliable, int depth)
+{
+  rclcpp::QoS qos(std::max(depth, 1));
+  if (reliable == 1) qos.reliable(); else qos.best_effort();
+  qos.durability_volatile();
+  return qos;
+}
+
+
+///////////////////////////////////// PONG /////////////////////////////////////
+template<typename MsgT>
+class PongNode : public rclcpp::Node
+{
+public:
+
+  PongNode(const rclcpp::NodeOptions & options) : Node("bench_pong", options)
+  {
+    int reliable = this->declare_parameter("reliable", 1);
+    int depth = this->declare_parameter("depth", 10);
+
+    pong_pub_ = this->create_publisher<MsgT>("bench_pong", bench_qos(reliable, depth));
+    ping_sub_ = this->create_subscription<MsgT>(
+      "bench_ping", bench_qos(reliable, depth), std::bind(&PongNode::ping_callback, this, std::placeholders::_1));
+  }
+
+private:
+
+  void ping_callback(const MsgT & msg) { pong_pub_->publish(msg); }
+
+  typename rclcpp::Publisher<MsgT>::SharedPtr pong_pub_;
+  typename rclcpp::Subscription<MsgT>::SharedPtr ping_sub_;
+};
+
+
+///////////////////////////////////// PING /////////////////////////////////////
+template<typename MsgT>
+class PingNode : public rclcpp::Node
+{
+public:
+
+  PingNode(const rclcpp::NodeOptions & options, const std::string & default_label) : Node("bench_ping", options)
+  {
+    msg_type = this->declare_parameter("msg_type", std::string("falconpos"));
+    rate = this->declare_parameter("rate", 1000);
+    duration = this->declare_parameter("duration", 10.0);
+    warmup = this->declare_parameter("warmup", 1.0);
+    reliable = this->declare_parameter("reliable", 1);
+    depth = this->declare_parameter("depth", 10);
+    payload = this->declare_parameter("payload", 4);
+    label = this->declare_parameter("label", default_label);
+    results_file = this->declare_parameter("results_file", std::string("transport_bench_results.csv"));
+
+    for (auto & t : send_times) t.store(-1);
+    for (auto & s : send_seqs) s.store(0);
+    long expected = (rate > 0 ? rate : 100000) * (long) (duration + 1.0);
+    rtts.reserve(std::max(expected, 1000L));
+
+    BenchTraits<MsgT>::init(msg, payload);
+    rclcpp::SerializedMessage serialized;
+    rclcpp::Serialization<MsgT>().serialize_message(&msg, &serialized);
+    msg_bytes = serialized.size();
+
+    ping_pub_ = this->create_publisher<MsgT>("bench_ping", bench_qos(reliable, depth));
+    pong_sub_ = this->create_subscription<MsgT>(
+      "bench_pong", bench_qos(reliable, depth), std::bind(&PingNode::pong_callback, this, std::placeholders::_1));
+
+    std::cout << "\nBenchmarking " << msg_type << " (" << msg_bytes << " bytes) over [" << label << "] at "
+              << (rate > 0 ? std::to_string(rate) + " Hz" : std::string("max rate")) << ", "
+              << (reliable == 1 ? "reliable" : "best effort") << ", depth " << depth << "\n" << std::endl;
+  }
+
+  // sender loop, runs on its own thread while the executor delivers the pongs
+  void run()
+  {
+    std::this_thread::sleep_for(1s);   // discovery
+
+    auto start = std::chrono::steady_clock::now();
+    auto measure_start = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(warmup));
+    auto stop = measure_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration));
+    auto period = rate > 0 ? std::chrono::nanoseconds(1000000000L / rate) : std::chrono::nanoseconds(0);
+    auto next = start;
+    uint64_t seq = 1;
+
+    while (rclcpp::ok()) {
+      auto now = std::chrono::steady_clock::now();
+      if (now >= stop) break;
+      if (now >= measure_start && first_measured_seq == 0) first_measured_seq = seq;
+
+      BenchTraits<MsgT>::set_seq(msg, seq);
+      send_seqs[seq % seq_ring_size].store(seq);
+      send_times[seq % seq_ring_size].store(now_ns());
+      ping_pub_->publish(msg);
+      if (first_measured_seq != 0) sent++;
+      seq++;
+
+      if (rate > 0) {
+        next += period;
+        std::this_thread::sleep_until(next);
+      }
+    }
+
+    std::this_thread::sleep_for(500ms);   // let the last pongs arrive
+    write_results();
+    rclcpp::shutdown();
+  }
+
+private:
+
+  void pong_callback(const MsgT & pong)
+  {
+    int64_t t = now_ns();
+    uint64_t seq = BenchTraits<MsgT>::get_seq(pong);
+    if (first_measured_seq == 0 || seq < first_measured_seq) return;
+    if (send_seqs[seq % seq_ring_size].load() != seq) return;   // overwritten, older than the ring
+    std::lock_guard<std::mutex> lock(rtt_mutex);
+    rtts.push_back(t - send_times[seq % seq_ring_size].load());
+  }
+
+  void write_results()
+  {
+    std::lock_guard<std::mutex> lock(rtt_mutex);
+    std::vector<int64_t> sorted = rtts;
+    std::sort(sorted.begin(), sorted.end());
+    auto pct = [&sorted](double p) { return sorted.empty() ? 0.0 : sorted.at((size_t) (p * (sorted.size() - 1))) / 1000.0; };
+    double mean = 0.0;
+    for (auto r : sorted) mean += r / 1000.0;
+    if (!sorted.empty()) mean /= sorted.size();
+    long received = sorted.size();
+    double loss = sent > 0 ? 100.0 * (sent - received) / sent : 0.0;
+
+    std::cout << "sent = " << sent << ", received = " << received << ", loss = " << loss << " %\n"
+              << "round trip [us]: mean = " << mean << ", p50 = " << pct(0.5) << ", p99 = " << pct(0.99)
+              << ", p99.9 = " << pct(0.999) << ", max = " << pct(1.0) << "\n"
+              << "throughput = " << received / duration << " round trips/s\n" << std::endl;
+
+    bool new_file = !std::ifstream(results_file).good();
+    std::ofstream file(results_file, std::ios::app);
+    if (!file.is_open()) {
+      std::cout << "Could not open " << results_file << std::endl;
+      return;
+    }
+    if (new_file) file << "label,msg_type,bytes,reliable,depth,rate,sent,received,loss_pct,mean_us,p50_us,p99_us,p999_us,max_us,throughput_hz\n";
+    file << label << "," << msg_type << "," << msg_bytes << "," << reliable << "," << depth << "," << rate << ","
+         << sent << "," << received << "," << loss << "," << mean << "," << pct(0.5) << "," << pct(0.99) << ","
+         << pct(0.999) << "," << pct(1.0) << "," << received / duration << "\n";
+  }
+
+  static int64_t now_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  std::string msg_type;
+  int rate {1000};
+  double duration {10.0};
+  double warmup {1.0};
+  int reliable {1};
+  int depth {10};
+  int payload {4};
+  std::string label;
+  std::string results_file;
+
+  MsgT msg;
+  size_t msg_bytes {0};
+
+  std::array<std::atomic<int64_t>, seq_ring_size> send_times;
+  std::array<std::atomic<uint64_t>, seq_ring_size> send_seqs;
+  std::atomic<uint64_t> first_measured_seq {0};
+  long sent {0};
+
+  std::mutex rtt_mutex;
+  std::vector<int64_t> rtts;
+
+  typename rclcpp::Publisher<MsgT>::SharedPtr ping_pub_;
+  typename rclcpp::Subscription<MsgT>::SharedPtr pong_sub_;
+};
+
+
+///////////////////////////////////// RUNNER /////////////////////////////////////
+template<typename MsgT>
+void run_benchmark(const std::string & mode)
+{
+  bool intra = (mode == "intra");
+  auto options = rclcpp::NodeOptions().use_intra_process_comms(intra);
+  rclcpp::executors::MultiThreadedExecutor executor;
+
+  std::shared_ptr<PongNode<MsgT>> pong;
+  std::shared_ptr<PingNode<MsgT>> ping;
+  if (mode == "pong" || intra) {
+    pong = std::make_shared<PongNode<MsgT>>(options);
+    executor.add_node(pong);
+  }
+  if (mode == "ping" || intra) {
+    ping = std::make_shared<PingNode<MsgT>>(options, intra ? "intra" : "inter");
+    executor.add_node(ping);
+  }
+
+  std::thread sender;
+  if (ping) sender = std::thread([ping]() { ping->run(); });
+  executor.spin();
+  if (sender.joinable()) sender.join();
+}
+
+// msg_type is needed before any node exists, so it is read from the command line here and declared again by the ping node
+std::string find_msg_type(int argc, char * argv[])
+{
+  for (int i=1; i<argc-1; i++) {
+    if (std::strcmp(argv[i], "-p") == 0 && std::strncmp(argv[i+1], "msg_type:=", 10) == 0) return std::string(argv[i+1] + 10);
+  }
+  return "falconpos";
+}
+
+int main(int argc, char * argv[])
+{
+  std::string mode = argc > 1 ? argv[1] : "";
+  if (mode != "intra" && mode != "ping" && mode != "pong") {
+    std::cout << "usage: transport_bench {intra|ping|pong} [--ros-args -p msg_type:=falconpos|posinfo|joint_state|marker_array ...]" << std::endl;
+    return 1;
+  }
+  std::string msg_type = find_msg_type(argc, argv);
+
+  rclcpp::init(argc, argv);
+  if (msg_type == "falconpos") run_benchmark<tutorial_interfaces::msg::Falconpos>(mode);
+  else if (msg_type == "posinfo") run_benchmark<tutorial_interfaces::msg::PosInfo>(mode);
+  else if (msg_type == "joint_state") run_benchmark<sensor_msgs::msg::JointState>(mode);
+  else if (msg_type == "marker_array") run_benchmark<visualization_msgs::msg::MarkerArray>(mode);
+  else std::cout << "Unknown msg_type " << msg_type << std::endl;
+  rclcpp::shutdown();
+  return 0;
+}